@@ -0,0 +1,84 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "boot_prof.h"
+#include "fsl_common.h"
+#include <stdio.h>
+
+static const char * const phase_name[kBootProf_Count] =
+{
+    "main",
+    "clock init",
+    "memory_init",
+    "sbl_nvm_init",
+    "crc check",
+    "golden scan",
+    "backup scan",
+    "promote",
+    "jump",
+};
+
+/* print the timeline, time of a phase is converted at the clock it started with */
+void boot_prof_print(const boot_prof_t *prof)
+{
+    const boot_prof_entry_t *e, *prev;
+    uint32_t i, first, us;
+
+    first = (prof->cnt > BOOT_PROF_RING_SIZE)?(prof->cnt - BOOT_PROF_RING_SIZE):(0);
+    prev = &prof->ring[first % BOOT_PROF_RING_SIZE];
+    us = 0;
+
+    printf("boot timeline, %u marks:\r\n", prof->cnt);
+    printf("  phase           cycles      delta       us\r\n");
+    for(i=first; i<prof->cnt; i++)
+    {
+        e = &prof->ring[i % BOOT_PROF_RING_SIZE];
+        us += (e->cycles - prev->cycles) / ((prev->mhz)?(prev->mhz):(1));
+        printf("  %-14s %10u %10u %8u\r\n", (e->id < kBootProf_Count)?(phase_name[e->id]):("?"),
+               e->cycles, e->cycles - prev->cycles, us);
+        prev = e;
+    }
+}
+
+#if (SBL_BOOT_PROFILE)
+
+/* address must match BOOT_PROF_ADDR */
+#ifdef __ICCARM__
+__no_init boot_prof_t boot_prof @ 0x04003E00;
+#else
+boot_prof_t boot_prof __attribute__((section(".bss.ARM.__at_0x04003E00")));
+#endif
+
+void boot_prof_init(void)
+{
+    /* start counting from here, memory_init keeps the counter running */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    boot_prof.magic = BOOT_PROF_MAGIC;
+    boot_prof.cnt = 0;
+    boot_prof_mark(kBootProf_Main);
+}
+
+void boot_prof_mark(uint32_t id)
+{
+    boot_prof_entry_t *e;
+
+    e = &boot_prof.ring[boot_prof.cnt % BOOT_PROF_RING_SIZE];
+    e->cycles = DWT->CYCCNT;
+    e->id = id;
+    e->mhz = SystemCoreClock / (1000*1000);
+    boot_prof.cnt++;
+}
+
+void boot_prof_dump(void)
+{
+    boot_prof_print(&boot_prof);
+}
+
+#endif
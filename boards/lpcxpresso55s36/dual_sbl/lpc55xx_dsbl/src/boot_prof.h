@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __BOOT_PROF_H__
+#define __BOOT_PROF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+#include "sbl_config.h"
+
+/*
+    boot timeline: each mark stores the DWT cycle counter at the end of a boot phase.
+    the ring lives at a fixed SRAMX address, the application finds it there after the jump
+    (check magic), it is also printed on the debug UART right before the jump.
+    cycles count from the start of main, the time from reset to main is not covered.
+*/
+#define BOOT_PROF_ADDR          (0x04003E00)    /* top of SRAMX, application must not use it */
+#define BOOT_PROF_MAGIC         (0x464F5250)    /* "PROF" */
+#define BOOT_PROF_RING_SIZE     (32)
+
+/* phases, value is stored in the ring */
+enum
+{
+    kBootProf_Main = 0,         /* main entered, counter started */
+    kBootProf_ClockInit,        /* pins, clocks, debug console */
+    kBootProf_MemoryInit,
+    kBootProf_NvmInit,
+    kBootProf_CrcCheck,         /* one image crc check done */
+    kBootProf_GoldenScan,
+    kBootProf_BackupScan,
+    kBootProf_Promote,          /* backup copied into golden */
+    kBootProf_Jump,
+    kBootProf_Count,
+};
+
+typedef struct
+{
+    uint16_t id;                /* phase, kBootProf_xxx */
+    uint16_t mhz;               /* core clock when marked */
+    uint32_t cycles;            /* DWT cycle counter when the phase ended */
+}boot_prof_entry_t;
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_PROF_MAGIC once initialized */
+    uint32_t cnt;               /* marks taken, mark n is in ring[n % BOOT_PROF_RING_SIZE] */
+    boot_prof_entry_t ring[BOOT_PROF_RING_SIZE];
+}boot_prof_t;
+
+#if (SBL_BOOT_PROFILE)
+#define BOOT_PROF_MARK(id)      boot_prof_mark(id)
+#else
+#define BOOT_PROF_MARK(id)
+#endif
+
+void boot_prof_init(void);
+void boot_prof_mark(uint32_t id);
+void boot_prof_dump(void);
+/* print a timeline, also used by the host decoder tools/boot_prof_decode.c on a memory dump */
+void boot_prof_print(const boot_prof_t *prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
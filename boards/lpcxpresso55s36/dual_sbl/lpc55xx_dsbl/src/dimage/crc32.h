@@ -10,6 +10,30 @@
 
 #include <stdint.h>
 
+/* CRC32 engine selection:
+    1: byte by byte, one 256-entry table (1KB)
+    4: slicing-by-4, word at a time (4KB tables)
+    8: slicing-by-8, two words at a time (8KB tables)
+*/
+#ifndef CRC32_SLICE_BY
+#define CRC32_SLICE_BY      (8)
+#endif
+
+#if (CRC32_SLICE_BY != 1) && (CRC32_SLICE_BY != 4) && (CRC32_SLICE_BY != 8)
+#error "CRC32_SLICE_BY must be 1, 4 or 8"
+#endif
+
+/* CRC32 backend: dimage hashes images through one of these */
+typedef struct
+{
+    void (*init)(uint32_t *crc);
+    void (*generate)(uint32_t *crc, uint8_t *buf, int len);
+    void (*complete)(uint32_t *crc);
+}crc32_backend_t;
+
+/* software table driven backend */
+extern const crc32_backend_t crc32_sw_backend;
+
 uint32_t crc32_compute(uint8_t *buf, int len);
 void crc32_complete(uint32_t *CRC);
 void crc32_generate(uint32_t *CRC, uint8_t *buf, int len);
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "crc32_hw.h"
+#include "fsl_crc.h"
+
+/*
+    CRC-32 (ISO-HDLC): poly 0x04C11DB7, seed 0xFFFFFFFF, reflected input and output,
+    complemented result. This is the MSB first form of the 0xEDB88320 software table.
+*/
+void crc32_hw_init(uint32_t *CRC)
+{
+    crc_config_t config;
+
+    config.polynomial = 0x04C11DB7;
+    config.seed = 0xFFFFFFFF;
+    config.reflectIn = true;
+    config.reflectOut = true;
+    config.complementChecksum = true;
+    config.crcBits = kCrcBits32;
+    config.crcResult = kCrcFinalChecksum;
+
+    CRC_Init(CRC0, &config);
+    *CRC = 0xFFFFFFFF;
+}
+
+void crc32_hw_generate(uint32_t *CRC, uint8_t *buf, int len)
+{
+    /* running value is kept by the engine */
+    (void)CRC;
+    if(len > 0)
+    {
+        CRC_WriteData(CRC0, buf, len);
+    }
+}
+
+void crc32_hw_complete(uint32_t *CRC)
+{
+    /* bit reversal and complement are applied by the engine on read */
+    *CRC = CRC_Get32bitResult(CRC0);
+}
+
+const crc32_backend_t crc32_hw_backend =
+{
+    crc32_hw_init,
+    crc32_hw_generate,
+    crc32_hw_complete,
+};
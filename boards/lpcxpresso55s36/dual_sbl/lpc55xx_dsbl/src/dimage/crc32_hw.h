@@ -0,0 +1,21 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef CRC32_HW_H
+#define CRC32_HW_H
+
+#include "crc32.h"
+
+/* CRC engine backend, gives the same result as the 0xEDB88320 software tables.
+   The engine keeps the running checksum, so only one CRC can be in progress at a time */
+extern const crc32_backend_t crc32_hw_backend;
+
+void crc32_hw_init(uint32_t *CRC);
+void crc32_hw_generate(uint32_t *CRC, uint8_t *buf, int len);
+void crc32_hw_complete(uint32_t *CRC);
+
+#endif
@@ -7,23 +7,35 @@
 
 #include "dimage.h"
 #include "crc32.h"
+#include "boot_prof.h"
 #include <string.h>
+#include <stddef.h>
 #include "memory.h"
 
 /* image layout follow LPC54xxx Dual Enhenced Image */
 
 #define DUAL_IMAGE_MAKRER               (0x0FFEB6B6)
-#define HEADER_BLOCK_MARKER             (0xFEEDA5A5)
 #define DUAL_IMAGE_MARKER_OFFSET        (0x24)
 #define DUAL_IMAGE_HDR_ADDR             (DUAL_IMAGE_MARKER_OFFSET + 4)
 
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+#endif
+
+/* crc backend used by image checking, software by default */
+static const crc32_backend_t *crc_backend = &crc32_sw_backend;
+
+void image_set_crc_backend(const crc32_backend_t *backend)
+{
+    crc_backend = backend;
+}
 
 void dump_hdr(ihdr_t *hdr)
 {
     DIMAGE_TRACE("%-16s :0x%08X\r\n", "sheader_marker", hdr->header_marker);
     DIMAGE_TRACE("%-16s :0x%08X\r\n", "image_type", hdr->img_type);
     DIMAGE_TRACE("%-16s :0x%08X\r\n", "reserved", hdr->reserved);
-    DIMAGE_TRACE("%-16s :%d\r\n",     "img_len", hdr->img_len);
+    DIMAGE_TRACE("%-16s :%u\r\n",     "img_len", hdr->img_len);
     DIMAGE_TRACE("%-16s :0x%08X\r\n", "crc_value", hdr->crc_value);
     DIMAGE_TRACE("%-16s :0x%08X\r\n", "version", hdr->version);
 }
@@ -43,13 +55,73 @@ int image_get_hdr(uint32_t addr, uint32_t load_addr, ihdr_t *hdr)
 }
 
 
+/* feed a range into crc: RAM in place, flash page by page, in place if the page can be mapped,
+   as erased value if it is blank, else copied through a small buffer. return 0 if all was read */
+static int _crc_update(uint32_t *crc, uint32_t addr, uint32_t len)
+{
+    uint8_t buf[64];
+    const uint8_t *p;
+    uint32_t n, m, k;
+    
+    if(!memory_is_flash(addr, len))
+    {
+        crc_backend->generate(crc, (uint8_t*)(uintptr_t)addr, len);
+        return 0;
+    }
+    
+    while(len)
+    {
+        n = MEMORY_PAGE_SIZE - (addr % MEMORY_PAGE_SIZE);
+        n = (len > n)?(n):(len);
+        
+        p = memory_map(addr, n);
+        if(p)
+        {
+            crc_backend->generate(crc, (uint8_t*)p, n);
+        }
+        else if(memory_is_blank(addr - (addr % MEMORY_PAGE_SIZE), MEMORY_PAGE_SIZE))
+        {
+            memset(buf, 0xFF, sizeof(buf));
+            for(m=0; m<n; m+=k)
+            {
+                k = (n - m > sizeof(buf))?(sizeof(buf)):(n - m);
+                crc_backend->generate(crc, buf, k);
+            }
+        }
+        else
+        {
+            for(m=0; m<n; m+=k)
+            {
+                k = (n - m > sizeof(buf))?(sizeof(buf)):(n - m);
+                if(memory_read(addr + m, buf, k) != 0)
+                {
+                    return 1;
+                }
+                crc_backend->generate(crc, buf, k);
+            }
+        }
+        addr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* CRC32 of any flash or RAM range with the current backend, same algorithm as image crc, 0: ok */
+int image_crc_range(uint32_t addr, uint32_t len, uint32_t *crc)
+{
+    crc_backend->init(crc);
+    if(_crc_update(crc, addr, len) != 0)
+    {
+        return 1;
+    }
+    crc_backend->complete(crc);
+    return 0;
+}
+
 /* do image crc checking */
 static int _crc_check(uint32_t addr, uint32_t load_addr)
 {
-    int i;
-    uint8_t buf[64];
     int ret;
-    int crc_len, crc_start;
     uint32_t cal_crc, crc_offset;
     ihdr_t hdr;
     
@@ -71,35 +143,16 @@ static int _crc_check(uint32_t addr, uint32_t load_addr)
                     break;
                 }
                 
-                crc32_init(&cal_crc);
-                
-                /* calcuate data before crc */
-                crc_len = crc_offset;
-                crc_start = addr;
+                crc_backend->init(&cal_crc);
                 
-                for(i=0; i<crc_len / sizeof(buf); i++)
+                /* calcuate data before and after crc, an unreadable page fails the image */
+                if((_crc_update(&cal_crc, addr, crc_offset) != 0) ||
+                   (_crc_update(&cal_crc, addr + crc_offset + 4, hdr.img_len - crc_offset) != 0))
                 {
-                    memory_read(crc_start + i*sizeof(buf), buf, sizeof(buf));
-                    crc32_generate(&cal_crc, buf, sizeof(buf));
-                }
-                
-                memory_read(crc_start + i*sizeof(buf), buf, crc_len % sizeof(buf));
-                crc32_generate(&cal_crc, buf, crc_len % sizeof(buf));
-                    
-                /* calcuate data after crc */
-                crc_len = hdr.img_len - crc_offset;
-                crc_start = crc_offset + 4 + addr;
-                  
-                for(i=0; i<crc_len / sizeof(buf); i++)
-                {
-                    memory_read(crc_start + i*sizeof(buf), buf, sizeof(buf));
-                    crc32_generate(&cal_crc, buf, sizeof(buf));
+                    break;
                 }
                 
-                memory_read(crc_start + i*sizeof(buf), buf, crc_len % sizeof(buf));
-                crc32_generate(&cal_crc, buf, crc_len % sizeof(buf));
-                
-                crc32_complete(&cal_crc);
+                crc_backend->complete(&cal_crc);
                 
                 if(cal_crc == hdr.crc_value)
                 {
@@ -113,47 +166,103 @@ static int _crc_check(uint32_t addr, uint32_t load_addr)
                 break;
         }
     }
+    
+    BOOT_PROF_MARK(kBootProf_CrcCheck);
     return ret;
 }
 
-/* scan flash to find vailid image */
-int image_scan(uint32_t start_addr, uint32_t load_addr, uint32_t len, uint32_t *image_addr, uint32_t max_image_cnt)
+/* check the image whose dual image marker was found at start_addr + offset, return 0 if it is valid */
+static int _image_probe(uint32_t start_addr, uint32_t load_addr, uint32_t offset)
 {
-    uint32_t marker;
-    int i;
-    uint32_t image_cnt, addr;
     uint32_t hdr_addr;
     ihdr_t hdr;
     
-    /* scan dual image marker and header */
-    image_cnt = 0;
+    memory_read(start_addr + offset + 4, (uint8_t*)&hdr_addr, sizeof(hdr_addr));
+    hdr_addr = hdr_addr - load_addr + start_addr;
+    memory_read(hdr_addr, (uint8_t*)&hdr, sizeof(ihdr_t));
+    if(hdr.header_marker != HEADER_BLOCK_MARKER)
+    {
+        return 1;
+    }
     
-    for(i=0; i<len/sizeof(marker); i++)
+    if(_crc_check(start_addr + offset - DUAL_IMAGE_MARKER_OFFSET, load_addr) != 0)
     {
-        memory_read(start_addr + i*sizeof(marker), (uint8_t*)&marker, sizeof(marker));
+        DIMAGE_TRACE("crc check failed\r\n");
+        return 1;
+    }
+    
+    return 0;
+}
 
-        if(marker == DUAL_IMAGE_MAKRER)
+/* scan flash to find vailid image */
+int image_scan(uint32_t start_addr, uint32_t load_addr, uint32_t len, uint32_t *image_addr, uint32_t max_image_cnt)
+{
+    uint32_t buf[64];
+    uint32_t i, j, n;
+    uint32_t image_cnt, offset;
+    const uint32_t *p;
+    
+    image_cnt = 0;
+    
+#if defined(DIMAGE_FAST_PROBE)
+    /* an image normally starts at the region start, try its marker first */
+    offset = DUAL_IMAGE_MARKER_OFFSET;
+    if(offset + sizeof(uint32_t) <= len)
+    {
+        if((memory_read(start_addr + offset, (uint8_t*)buf, sizeof(uint32_t)) == 0) &&
+           (buf[0] == DUAL_IMAGE_MAKRER) && (_image_probe(start_addr, load_addr, offset) == 0))
         {
-            memory_read(start_addr + i*sizeof(marker) + 4, (uint8_t*)&hdr_addr, sizeof(hdr_addr));
-            hdr_addr = hdr_addr - load_addr + start_addr;
-            memory_read(hdr_addr, (uint8_t*)&hdr, sizeof(ihdr_t));
-            if(hdr.header_marker == HEADER_BLOCK_MARKER)
+            image_addr[image_cnt] = start_addr;
+            image_cnt++;
+            
+            if(max_image_cnt == image_cnt)
             {
-                addr = start_addr + i*sizeof(marker) - DUAL_IMAGE_MARKER_OFFSET;
-                if(_crc_check(addr, load_addr) == 0)
-                {
-                    /* image found */
-                    image_addr[image_cnt] = addr;
-                    image_cnt++;
-                    
-                    if(max_image_cnt == image_cnt)
-                    {
-                        return image_cnt;
-                    }
-                }
-                else
+                return image_cnt;
+            }
+        }
+    }
+#endif
+    
+    /* scan dual image marker and header, in place if the scan window can be mapped, else in bulk reads */
+    p = (const uint32_t *)memory_map(start_addr, len);
+    
+    for(i=0; i<len/sizeof(uint32_t); i+=n)
+    {
+        n = len/sizeof(uint32_t) - i;
+        n = (n > ARRAY_SIZE(buf))?(ARRAY_SIZE(buf)):(n);
+        
+        if(!p)
+        {
+            if(memory_read(start_addr + i*sizeof(uint32_t), (uint8_t*)buf, n*sizeof(uint32_t)) != 0)
+            {
+                continue;
+            }
+        }
+        
+        for(j=0; j<n; j++)
+        {
+            if(((p)?(p[i+j]):(buf[j])) != DUAL_IMAGE_MAKRER)
+            {
+                continue;
+            }
+            
+            offset = (i + j)*sizeof(uint32_t);
+#if defined(DIMAGE_FAST_PROBE)
+            if(offset == DUAL_IMAGE_MARKER_OFFSET)
+            {
+                /* already probed */
+                continue;
+            }
+#endif
+            if(_image_probe(start_addr, load_addr, offset) == 0)
+            {
+                /* image found */
+                image_addr[image_cnt] = start_addr + offset - DUAL_IMAGE_MARKER_OFFSET;
+                image_cnt++;
+                
+                if(max_image_cnt == image_cnt)
                 {
-                    DIMAGE_TRACE("crc check failed\r\n");
+                    return image_cnt;
                 }
             }
         }
@@ -161,3 +270,140 @@ int image_scan(uint32_t start_addr, uint32_t load_addr, uint32_t len, uint32_t *
     return image_cnt;
 }
 
+/*
+    streaming crc: the software backend is used so the CRC engine stays free for other users
+    while data arrives. the crc word position is known once the dual image marker and header
+    pointer at the image start are seen, the crc length once the header itself has passed.
+*/
+void image_stream_begin(image_stream_t *s, uint32_t start_addr, uint32_t load_addr)
+{
+    memset(s, 0, sizeof(image_stream_t));
+    s->start_addr = start_addr;
+    s->load_addr = load_addr;
+    s->state = kImageStream_Active;
+    crc32_sw_backend.init(&s->crc);
+}
+
+/* feed image bytes [off, off + len) into crc, leaving out the crc word */
+static void _stream_crc(image_stream_t *s, uint32_t off, const uint8_t *buf, uint32_t len)
+{
+    uint32_t crc_off, n;
+    
+    crc_off = s->hdr_off + offsetof(ihdr_t, crc_value);
+    
+    if(off < crc_off)
+    {
+        n = ((crc_off - off) > len)?(len):(crc_off - off);
+        crc32_sw_backend.generate(&s->crc, (uint8_t*)buf, n);
+        off += n;
+        buf += n;
+        len -= n;
+    }
+    
+    if(len && (off < crc_off + sizeof(uint32_t)))
+    {
+        n = ((crc_off + sizeof(uint32_t) - off) > len)?(len):(crc_off + sizeof(uint32_t) - off);
+        off += n;
+        buf += n;
+        len -= n;
+    }
+    
+    if(len)
+    {
+        crc32_sw_backend.generate(&s->crc, (uint8_t*)buf, len);
+    }
+}
+
+void image_stream_update(image_stream_t *s, uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    uint32_t marker, hdr_ptr, lo, hi, end;
+    
+    if(s->state != kImageStream_Active)
+    {
+        return;
+    }
+    
+    /* only data written back to back can be streamed */
+    if(addr != s->start_addr + s->pos)
+    {
+        s->state = kImageStream_Invalid;
+        return;
+    }
+    
+    if(s->pos == 0)
+    {
+        if(len < DUAL_IMAGE_HDR_ADDR + sizeof(uint32_t))
+        {
+            s->state = kImageStream_Invalid;
+            return;
+        }
+        
+        memcpy(&marker, buf + DUAL_IMAGE_MARKER_OFFSET, sizeof(uint32_t));
+        memcpy(&hdr_ptr, buf + DUAL_IMAGE_HDR_ADDR, sizeof(uint32_t));
+        s->hdr_off = hdr_ptr - s->load_addr;
+        if((marker != DUAL_IMAGE_MAKRER) || (s->hdr_off > 512*1024))
+        {
+            s->state = kImageStream_Invalid;
+            return;
+        }
+    }
+    
+    /* pick up the header as it passes */
+    lo = (s->pos > s->hdr_off)?(s->pos):(s->hdr_off);
+    hi = ((s->pos + len) < (s->hdr_off + sizeof(ihdr_t)))?(s->pos + len):(s->hdr_off + sizeof(ihdr_t));
+    if(lo < hi)
+    {
+        memcpy((uint8_t*)&s->hdr + lo - s->hdr_off, buf + lo - s->pos, hi - lo);
+    }
+    
+    /* crc covers img_len bytes besides the crc word, stop there once the header is known */
+    end = s->pos + len;
+    if((end >= s->hdr_off + sizeof(ihdr_t)) && (end > s->hdr.img_len + sizeof(uint32_t)))
+    {
+        end = s->hdr.img_len + sizeof(uint32_t);
+    }
+    
+    if(end > s->pos)
+    {
+        _stream_crc(s, s->pos, buf, end - s->pos);
+    }
+    
+    s->pos += len;
+}
+
+/* return 0 and the image header if a complete image with matching crc has been streamed */
+int image_stream_finish(image_stream_t *s, ihdr_t *hdr)
+{
+    uint32_t crc;
+    
+    if((s->state != kImageStream_Active) || (s->pos < s->hdr_off + sizeof(ihdr_t)) ||
+       (s->hdr.header_marker != HEADER_BLOCK_MARKER))
+    {
+        return 1;
+    }
+    
+    switch(s->hdr.img_type)
+    {
+        case 0: /* need crc check */
+            if((s->hdr_off + offsetof(ihdr_t, crc_value) > s->hdr.img_len) ||
+               (s->pos < s->hdr.img_len + sizeof(uint32_t)))
+            {
+                return 1;
+            }
+            
+            crc = s->crc;
+            crc32_sw_backend.complete(&crc);
+            if(crc != s->hdr.crc_value)
+            {
+                return 1;
+            }
+            break;
+        case 1: /* no crc check */
+            break;
+        default:
+            return 1;
+    }
+    
+    *hdr = s->hdr;
+    return 0;
+}
@@ -13,9 +13,13 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include "crc32.h"
 
 #define DIMAGE_DEBUG
 
+/* probe the marker at the fixed image offset before scanning the whole window */
+#define DIMAGE_FAST_PROBE
+
 #if defined(DIMAGE_DEBUG)
 #include <stdio.h>
 #define DIMAGE_TRACE	printf
@@ -23,6 +27,8 @@
 #define DIMAGE_TRACE(...)
 #endif
 
+#define HEADER_BLOCK_MARKER             (0xFEEDA5A5)
+
 /* generate image via: ./image_generator.exe -s ./MDK/lpc54608/se_image.bin ./se_image_crc.bin */
 
 typedef struct
@@ -35,11 +41,34 @@ typedef struct
     uint32_t version;                           /*!< Image version for multi-image support */
 }ihdr_t;
 
+enum
+{
+    kImageStream_Idle = 0,
+    kImageStream_Active,
+    kImageStream_Invalid,
+};
+
+/* crc of an image computed while it is being written, in address order from its start */
+typedef struct
+{
+    uint32_t start_addr;        /* where the image is written */
+    uint32_t load_addr;         /* where the image is linked */
+    uint32_t pos;               /* bytes seen so far */
+    uint32_t hdr_off;           /* header offset in image */
+    uint32_t crc;
+    uint32_t state;
+    ihdr_t   hdr;
+}image_stream_t;
 
 
 void dump_hdr(ihdr_t *hdr);
 int image_scan(uint32_t start_addr, uint32_t load_addr, uint32_t len, uint32_t *image_addr, uint32_t max_image_cnt);
 int image_get_hdr(uint32_t addr, uint32_t load_addr, ihdr_t *hdr);
+void image_set_crc_backend(const crc32_backend_t *backend);
+int image_crc_range(uint32_t addr, uint32_t len, uint32_t *crc);
+void image_stream_begin(image_stream_t *s, uint32_t start_addr, uint32_t load_addr);
+void image_stream_update(image_stream_t *s, uint32_t addr, const uint8_t *buf, uint32_t len);
+int image_stream_finish(image_stream_t *s, ihdr_t *hdr);
 
 
 #ifdef __cplusplus
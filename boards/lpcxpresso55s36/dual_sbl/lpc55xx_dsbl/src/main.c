@@ -12,20 +12,37 @@
 #include "fsl_flash_ffr.h"
 #include "fsl_common.h"
 #include "pin_mux.h"
+#include <string.h>
 
 #include "memory.h"
 #include "dimage.h"
+#include "crc32_hw.h"
 #include "mcuboot.h"
+#include "uart_dma.h"
 #include "sbl_api.h"
 #include "sbl_config.h"
+#include "boot_prof.h"
+#include "promote.h"
 
 /* mcuboot instance */
 static mcuboot_t mcuboot;
 
-int sbl_nvm_init(sbl_nvm_t* ctx);
-int sbl_nvm_write(sbl_nvm_t* ctx);
 extern bool re_invoke_flag;
 
+/* set once mcuboot has started to modify flash in this session */
+static bool flash_modified = false;
+
+/* crc of the image being downloaded into backup region, and whether programming failed */
+static image_stream_t img_stream;
+static bool flash_write_err = false;
+
+/* address images of a region are linked for */
+#if (SBL_AB_BOOT)
+#define IMAGE_LOAD_ADDR(region)     (region)
+#else
+#define IMAGE_LOAD_ADDR(region)     (GOLDEN_REGION_START)
+#endif
+
 static int mcuboot_send(uint8_t *buf, uint32_t len)
 {
     USART_WriteBlocking(USART0, buf, len);
@@ -61,6 +78,49 @@ void JumpToImage(uint32_t addr)
     __NOP();
 }
 
+/* divider search of USART_SetBaudRate without touching the UART: 0 if baud is within 3% */
+static int mcuboot_check_baud(uint32_t baud)
+{
+    uint32_t clk = CLOCK_GetFlexCommClkFreq(0);
+    uint32_t osr, brg, rate, diff, best = (uint32_t)-1;
+    uint32_t allowed = (baud / 100) * 3;
+    
+    if((baud == 0) || (clk == 0))
+    {
+        return -1;
+    }
+    for(osr=15; osr>=4; osr--)
+    {
+        if((osr <= 8) && (best <= allowed))
+        {
+            break;
+        }
+        brg = (((clk * 10) / ((osr + 1) * baud)) - 5) / 10;
+        if(brg > 0xFFFF)
+        {
+            continue;
+        }
+        rate = clk / ((osr + 1) * (brg + 1));
+        diff = (baud < rate)?(rate - baud):(baud - rate);
+        best = (diff < best)?(diff):(best);
+    }
+    return (best <= allowed)?(0):(-1);
+}
+
+static int mcuboot_set_baud(uint32_t baud)
+{
+    /* wait until the response has left at the old rate */
+    while(!(USART_GetStatusFlags(USART0) & kUSART_TxFifoEmptyFlag));
+    while(!(USART0->STAT & USART_STAT_TXIDLE_MASK));
+    
+    return USART_SetBaudRate(USART0, baud, CLOCK_GetFlexCommClkFreq(0));
+}
+
+static uint32_t mcuboot_get_tick(void)
+{
+    return DWT->CYCCNT;
+}
+
 static void mcuboot_reset(void)
 {
     /* delay for a while to wait mcuboot send respond packet */
@@ -70,22 +130,172 @@ static void mcuboot_reset(void)
 static void mcuboot_jump(uint32_t addr, uint32_t arg, uint32_t sp)
 {
     /* clean up */
+#if (SBL_USE_UART_DMA)
+    uart_dma_rx_deinit();
+#else
     USART_DisableInterrupts(USART0, kUSART_RxLevelInterruptEnable | kUSART_RxErrorInterruptEnable);
+#endif
     
     DIMAGE_TRACE("dsbl: boot @ 0x%08X\r\n", addr);
     
+#if (SBL_BOOT_PROFILE)
+    boot_prof_mark(kBootProf_Jump);
+    boot_prof_dump();
+#endif
+    
     JumpToImage(addr);
 }
 
+#if (SBL_USE_UART_DMA)
+static void mcuboot_uart_rx(uint8_t *buf, uint32_t len)
+{
+    /* feed a received batch into mcuboot */
+    mcuboot_recv(&mcuboot, buf, len);
+}
+#endif
+
+static void mcuboot_flash_modify(void)
+{
+    /* first erase or write of this session, drop cached image records */
+    if(!flash_modified)
+    {
+        flash_modified = true;
+        sbl_nvm_new_write_gen();
+    }
+}
+
+static int mcuboot_mem_erase(uint32_t addr, uint32_t len)
+{
+    mcuboot_flash_modify();
+    
+    /* data already streamed may be gone */
+    img_stream.state = kImageStream_Idle;
+    return memory_erase(addr, len);
+}
+
+static int mcuboot_mem_erase_start(uint32_t addr, uint32_t len)
+{
+    mcuboot_flash_modify();
+    
+    /* data already streamed may be gone */
+    img_stream.state = kImageStream_Idle;
+    return memory_erase_start(addr, len);
+}
+
+static int mcuboot_mem_write(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    int ret;
+    
+    mcuboot_flash_modify();
+    
+    /* a new image starts at the update region, crc it while it is written */
+    if(addr == mcuboot.cfg_flash_start)
+    {
+        image_stream_begin(&img_stream, addr, IMAGE_LOAD_ADDR(addr));
+        flash_write_err = false;
+    }
+    image_stream_update(&img_stream, addr, buf, len);
+    
+    ret = memory_write(addr, buf, len);
+    if(ret)
+    {
+        flash_write_err = true;
+    }
+    return ret;
+}
+
 static void mcuboot_complete(void)
 {
     sbl_nvm_t sbl_nvm;
-    sbl_nvm.marker = BL_DATA_MARKER;
+    sbl_image_rec_t *rec;
+    ihdr_t hdr;
+    
+    sbl_nvm_init(&sbl_nvm);
     sbl_nvm.update_flag = 0;
     sbl_nvm.update_retry_cnt = 0;
+    
+    /* downloaded image crc already checked, next boot can trust it without re-reading */
+    if((!flash_write_err) && (image_stream_finish(&img_stream, &hdr) == 0))
+    {
+        rec = &sbl_nvm.image_rec[(mcuboot.cfg_flash_start == GOLDEN_REGION_START)?(kSblImageRec_Golden):(kSblImageRec_Backup)];
+        rec->region = mcuboot.cfg_flash_start;
+        rec->image_addr = mcuboot.cfg_flash_start;
+        rec->crc_value = hdr.crc_value;
+        rec->version = hdr.version;
+        rec->img_len = hdr.img_len;
+        rec->write_gen = sbl_nvm.write_gen;
+    }
+    
     sbl_nvm_write(&sbl_nvm);
+
+    /* session closed, the next erase or write starts a new write generation */
+    flash_modified = false;
 }
 
+/* find a image in a region, full crc check is skipped if the image matches its verified record */
+static int region_scan(uint32_t region, sbl_nvm_t *nvm, sbl_image_rec_t *rec, uint32_t *addr, ihdr_t *hdr)
+{
+    int cnt;
+    uint32_t read_cnt;
+    
+    if((rec->region == region) && (rec->write_gen == nvm->write_gen))
+    {
+        image_get_hdr(rec->image_addr, IMAGE_LOAD_ADDR(region), hdr);
+        if((hdr->header_marker == HEADER_BLOCK_MARKER) && (hdr->crc_value == rec->crc_value) &&
+           (hdr->version == rec->version) && (hdr->img_len == rec->img_len))
+        {
+            DIMAGE_TRACE("verified record match, skip crc check\r\n");
+            *addr = rec->image_addr;
+            return 1;
+        }
+    }
+    
+    read_cnt = memory_get_stat()->read_cnt;
+    cnt = image_scan(region, IMAGE_LOAD_ADDR(region), 512, addr, 1);
+    DIMAGE_TRACE("flash read calls: %d\r\n", memory_get_stat()->read_cnt - read_cnt);
+    
+    /* refresh the record */
+    memset(rec, 0, sizeof(sbl_image_rec_t));
+    if(cnt)
+    {
+        image_get_hdr(*addr, IMAGE_LOAD_ADDR(region), hdr);
+        rec->region = region;
+        rec->image_addr = *addr;
+        rec->crc_value = hdr->crc_value;
+        rec->version = hdr->version;
+        rec->img_len = hdr->img_len;
+        rec->write_gen = nvm->write_gen;
+    }
+    return cnt;
+}
+
+/* region holding the newest valid image, 0: none */
+static uint32_t image_newest(int gimage_cnt, ihdr_t *ghdr, int bimage_cnt, ihdr_t *bhdr)
+{
+    if(bimage_cnt && ((!gimage_cnt) || (ghdr->version < bhdr->version)))
+    {
+        return BACKUP_REGION_START;
+    }
+    return (gimage_cnt)?(GOLDEN_REGION_START):(0);
+}
+
+#if (SBL_AB_BOOT)
+/* A/B: download into the slot not holding the newest image, it stays as fallback */
+static uint32_t ab_update_slot(void)
+{
+    int gimage_cnt, bimage_cnt;
+    uint32_t gaddr, baddr;
+    ihdr_t ghdr, bhdr;
+    sbl_nvm_t sbl_nvm;
+    
+    sbl_nvm_init(&sbl_nvm);
+    gimage_cnt = region_scan(GOLDEN_REGION_START, &sbl_nvm, &sbl_nvm.image_rec[kSblImageRec_Golden], &gaddr, &ghdr);
+    bimage_cnt = region_scan(BACKUP_REGION_START, &sbl_nvm, &sbl_nvm.image_rec[kSblImageRec_Backup], &baddr, &bhdr);
+    
+    return (image_newest(gimage_cnt, &ghdr, bimage_cnt, &bhdr) == GOLDEN_REGION_START)?(BACKUP_REGION_START):(GOLDEN_REGION_START);
+}
+#endif
+
 /* do dual image policy and boot application if everything ok */
 static int image_check_and_boot(void)
 {
@@ -96,62 +306,82 @@ static int image_check_and_boot(void)
         bimage_cnt: how many backup image in backup area
     */
   
-    int gimage_cnt, bimage_cnt, len;
-    uint32_t gaddr, baddr;
+    int gimage_cnt, bimage_cnt;
+    uint32_t gaddr, baddr, boot_addr, t;
     ihdr_t ghdr, bhdr;
+    sbl_nvm_t sbl_nvm, sbl_nvm_old;
+    
+    t = DWT->CYCCNT;
+    sbl_nvm_init(&sbl_nvm);
+    sbl_nvm_old = sbl_nvm;
     
-    /* scan a image in golden region */
+    /* scan a image in golden region, a journaled promotion left it incomplete */
     DIMAGE_TRACE("scan golden region...\r\n");
-    gimage_cnt = image_scan(GOLDEN_REGION_START, GOLDEN_REGION_START, 512, &gaddr, 1);
+    gimage_cnt = (sbl_nvm.promote_src)?(0):(region_scan(GOLDEN_REGION_START, &sbl_nvm, &sbl_nvm.image_rec[kSblImageRec_Golden], &gaddr, &ghdr));
+    BOOT_PROF_MARK(kBootProf_GoldenScan);
     if(gimage_cnt)
     {
         DIMAGE_TRACE("image found: 0x%08X\r\n", gaddr);
-        image_get_hdr(gaddr, GOLDEN_REGION_START, &ghdr);
         dump_hdr(&ghdr);
     }
     
     /* scan a image in backup region */
     DIMAGE_TRACE("scan backup region...\r\n");
-    bimage_cnt = image_scan(BACKUP_REGION_START, GOLDEN_REGION_START, 512, &baddr, 1);
+    bimage_cnt = region_scan(BACKUP_REGION_START, &sbl_nvm, &sbl_nvm.image_rec[kSblImageRec_Backup], &baddr, &bhdr);
+    BOOT_PROF_MARK(kBootProf_BackupScan);
     if(bimage_cnt)
     {
         DIMAGE_TRACE("image found: 0x%08X\r\n", baddr);
-        image_get_hdr(baddr, GOLDEN_REGION_START, &bhdr);
         dump_hdr(&bhdr);
     }
 
-    if((!gimage_cnt) && (bimage_cnt))
+    boot_addr = image_newest(gimage_cnt, &ghdr, bimage_cnt, &bhdr);
+    
+#if (!SBL_AB_BOOT)
+    /* golden region is rewritten when backup is promoted, verify it again on next boot */
+    if(boot_addr == BACKUP_REGION_START)
     {
-        DIMAGE_TRACE("golen image bad, backup ok\r\n");
-        
-        /* copy to golen image and boot */
-        (bhdr.img_type == 0x00000001)?(len = BACKUP_REGION_LEN):(len = bhdr.img_len + 4);
-        memory_copy(GOLDEN_REGION_START, baddr, len);
-        mcuboot_jump(GOLDEN_REGION_START, 0, 0);
+        memset(&sbl_nvm.image_rec[kSblImageRec_Golden], 0, sizeof(sbl_image_rec_t));
     }
+#endif
     
-    if(gimage_cnt && (!bimage_cnt))
+    /* save records only if something changed */
+    if(memcmp(&sbl_nvm, &sbl_nvm_old, sizeof(sbl_nvm_t)))
     {
-        DIMAGE_TRACE("golen image ok, no backup image, boot\r\n");
-        
-        mcuboot_jump(GOLDEN_REGION_START, 0, 0);
+        sbl_nvm_write(&sbl_nvm);
+    }
+    
+    if(!boot_addr)
+    {
+        return 1;
     }
     
-    if(gimage_cnt && bimage_cnt)
+#if (SBL_AB_BOOT)
+    DIMAGE_TRACE("A/B boot, newest valid slot runs in place\r\n");
+#else
+    if(boot_addr == BACKUP_REGION_START)
     {
-        if(ghdr.version < bhdr.version)
+        DIMAGE_TRACE("golden image bad or older than backup, copy backup to golden area\r\n");
+        
+        /* copy backup into golden, golden is half written if it fails: stay in mcuboot, journal left open */
+        if(image_promote(baddr, &bhdr, &sbl_nvm) != 0)
         {
-            DIMAGE_TRACE("backup image version higer, copy to golden area\r\n");
-            
-            /* copy backup into golden */
-            (bhdr.img_type == 0x00000001)?(len = BACKUP_REGION_LEN):(len = bhdr.img_len + 4);
-            memory_copy(GOLDEN_REGION_START, baddr, len);
+            DIMAGE_TRACE("promotion failed, enter dual bootloader\r\n");
+            return 1;
         }
-        
+        BOOT_PROF_MARK(kBootProf_Promote);
+        boot_addr = GOLDEN_REGION_START;
+    }
+    else
+    {
         DIMAGE_TRACE("golden image has same or higher version then backup, boot golen image\r\n");
-        
-        mcuboot_jump(GOLDEN_REGION_START, 0, 0);
     }
+#endif
+    
+    /* compare boot time of A/B and copy mode */
+    DIMAGE_TRACE("boot decision: %d cycles\r\n", DWT->CYCCNT - t);
+    
+    mcuboot_jump(boot_addr, 0, 0);
     
     return 1;
 }
@@ -161,6 +391,10 @@ int main(void)
 {
     sbl_nvm_t sbl_nvm;
     
+#if (SBL_BOOT_PROFILE)
+    boot_prof_init();
+#endif
+    
     /* Init board hardware. */
     /* attach main clock divide to FLEXCOMM0 (debug console) */
     CLOCK_SetClkDiv(kCLOCK_DivFlexcom0Clk, 0u, false);
@@ -174,6 +408,7 @@ int main(void)
     BOARD_InitPins();
     BOARD_BootClockFROHF96M();
     BOARD_InitDebugConsole();
+    BOOT_PROF_MARK(kBootProf_ClockInit);
     
     DIMAGE_TRACE("CoreClock:%dHz\r\n", CLOCK_GetFreq(kCLOCK_CoreSysClk));
     
@@ -183,8 +418,27 @@ int main(void)
     GPIO_PinInit(GPIO, 0, 17, &led_config);
     
     memory_init();
+    BOOT_PROF_MARK(kBootProf_MemoryInit);
+    
+#if (SBL_USE_HW_CRC)
+    image_set_crc_backend(&crc32_hw_backend);
+#endif
     
     sbl_nvm_init(&sbl_nvm);
+    BOOT_PROF_MARK(kBootProf_NvmInit);
+    
+#if defined(DIMAGE_DEBUG)
+    {
+        sbl_nvm_stat_t nvm_stat;
+        
+        /* parameter area wear, one more pass over the log, trace builds only */
+        if(sbl_nvm_get_stat(&nvm_stat) == 0)
+        {
+            DIMAGE_TRACE("nvm: %u records, bank %u, bank erases %u/%u\r\n", nvm_stat.write_cnt, nvm_stat.active_bank,
+                         nvm_stat.bank_erase_cnt[0], nvm_stat.bank_erase_cnt[1]);
+        }
+    }
+#endif
 
     /* if update_rey cnt > MAX time, clear update flag */
     if(sbl_nvm.update_flag)
@@ -208,20 +462,31 @@ int main(void)
     
     DIMAGE_TRACE("enter dual bootloader\r\n");
 
-    USART_EnableInterrupts(USART0, kUSART_RxLevelInterruptEnable | kUSART_RxErrorInterruptEnable);
-    EnableIRQ(FLEXCOMM0_IRQn);
-    
     /* config and init the mcuboot */
     mcuboot.op_send = mcuboot_send;
     mcuboot.op_reset = mcuboot_reset;
     mcuboot.op_jump = mcuboot_jump;
     mcuboot.op_complete = mcuboot_complete;
+    mcuboot.op_get_tick = mcuboot_get_tick;
+    mcuboot.cfg_tick_freq = CLOCK_GetFreq(kCLOCK_CoreSysClk);
+    mcuboot.op_check_baud = mcuboot_check_baud;
+    mcuboot.op_set_baud = mcuboot_set_baud;
+    mcuboot.cfg_uart_baud = BOARD_DEBUG_UART_BAUDRATE;
     
-    mcuboot.op_mem_erase = memory_erase;
-    mcuboot.op_mem_write = memory_write;
+    mcuboot.op_mem_erase = mcuboot_mem_erase;
+    mcuboot.op_mem_write = mcuboot_mem_write;
     mcuboot.op_mem_read = memory_read;
+    mcuboot.op_mem_erase_start = mcuboot_mem_erase_start;
+    mcuboot.op_mem_erase_poll = memory_erase_poll;
+    mcuboot.op_mem_map = memory_map;
+    mcuboot.op_mem_crc32 = image_crc_range;
     
+#if (SBL_AB_BOOT)
+    mcuboot.cfg_flash_start = ab_update_slot();
+    DIMAGE_TRACE("update slot: 0x%08X\r\n", mcuboot.cfg_flash_start);
+#else
     mcuboot.cfg_flash_start = BACKUP_REGION_START;
+#endif
     mcuboot.cfg_flash_size = BACKUP_REGION_LEN;
     mcuboot.cfg_ram_start = 0x20000000;
     mcuboot.cfg_ram_size = 128*1024;
@@ -230,9 +495,19 @@ int main(void)
     
     mcuboot_init(&mcuboot);
 
+#if (SBL_USE_UART_DMA)
+    uart_dma_rx_init(mcuboot_uart_rx);
+#else
+    USART_EnableInterrupts(USART0, kUSART_RxLevelInterruptEnable | kUSART_RxErrorInterruptEnable);
+    EnableIRQ(FLEXCOMM0_IRQn);
+#endif
     
     while(1)
     {
+#if (SBL_USE_UART_DMA)
+        /* line idle or half not filled yet: decode what has arrived so far */
+        uart_dma_rx_poll();
+#endif
         mcuboot_proc(&mcuboot);
     }
 }
@@ -22,11 +22,55 @@
 #define CH_ERR  (1)
 #endif
 
+#if (KPTL_CRC16_IMPL == 2)
+#include "fsl_crc.h"
+#endif
+
+#if (KPTL_CRC16_IMPL == 1)
+/* CRC-16/XMODEM, poly 0x1021, MSB first */
+static const uint16_t crc16_table[256] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+#endif
+
 /* generate CRC16
     @param  currectCrc:     previous buffer pointer, if is a new start, pointer should refer a zero uint16_t
     @param  src:            current buffer pointer
     @param  lengthInBytes:  length of current buf
 */
+#if (KPTL_CRC16_IMPL == 0)
 void crc16_update(uint16_t *currectCrc, const uint8_t *src, uint32_t lengthInBytes)
 {
     uint32_t crc = *currectCrc;
@@ -48,6 +92,43 @@ void crc16_update(uint16_t *currectCrc, const uint8_t *src, uint32_t lengthInByt
     } 
     *currectCrc = crc;
 }
+#elif (KPTL_CRC16_IMPL == 1)
+void crc16_update(uint16_t *currectCrc, const uint8_t *src, uint32_t lengthInBytes)
+{
+    uint32_t crc = *currectCrc;
+    uint32_t j;
+    for (j=0; j < lengthInBytes; ++j)
+    {
+        crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ src[j]) & 0xFF];
+    }
+    *currectCrc = crc & 0xFFFF;
+}
+#elif (KPTL_CRC16_IMPL == 2)
+void crc16_update(uint16_t *currectCrc, const uint8_t *src, uint32_t lengthInBytes)
+{
+    crc_config_t config;
+
+    if(!lengthInBytes)
+    {
+        return;
+    }
+    
+    /* continue from the previous value, no reflection, no final xor */
+    config.polynomial = 0x1021;
+    config.seed = *currectCrc;
+    config.reflectIn = false;
+    config.reflectOut = false;
+    config.complementChecksum = false;
+    config.crcBits = kCrcBits16;
+    config.crcResult = kCrcFinalChecksum;
+
+    CRC_Init(CRC0, &config);
+    CRC_WriteData(CRC0, src, lengthInBytes);
+    *currectCrc = CRC_Get16bitResult(CRC0);
+}
+#else
+#error "KPTL_CRC16_IMPL must be 0, 1 or 2"
+#endif
 
 void kptl_create_ping(packet_ping_t *p)
 {
@@ -67,20 +148,37 @@ void kptl_create_nak(packet_nak_t *p)
     p->packet_type = kFramingPacketType_Nak;
 }
     
-void kptl_create_cmd_packet(frame_packet_t *fp, cmd_packet_t *cp, uint32_t *param)
+/* write only the bytes that go on the wire: 4 byte command header followed by the parameters */
+static void kptl_put_cmd(frame_packet_t *fp, uint8_t tag, uint8_t flags, uint8_t param_cnt, const uint32_t *param)
 {
-    int i;
-    kptl_frame_packet_begin(fp, kFramingPacketType_Command);
-    kptl_frame_packet_add(fp, (uint8_t*)cp, 4);
-    cp->param = param;
-    for(i=0; i<cp->param_cnt; i++)
+    uint16_t len;
+    
+    /* the count is one byte on the wire, from 1020 byte packets on any count fits */
+#if (((MAX_PACKET_LEN - 4) / 4) < 255)
+    if(param_cnt > (MAX_PACKET_LEN - 4) / 4)
     {
-        kptl_frame_packet_add(fp, (uint8_t *)&cp->param[i], sizeof(uint32_t));
+        param_cnt = (MAX_PACKET_LEN - 4) / 4;
     }
+#endif
+    len = 4 + param_cnt*sizeof(uint32_t);
     
+    kptl_frame_packet_begin(fp, kFramingPacketType_Command);
+    fp->payload[0] = tag;
+    fp->payload[1] = flags;
+    fp->payload[2] = 0x00;
+    fp->payload[3] = param_cnt;
+    memcpy(&fp->payload[4], param, param_cnt*sizeof(uint32_t));
+    fp->len[0] = (len >> 0) & 0xFF;
+    fp->len[1] = (len >> 8) & 0xFF;
     kptl_frame_packet_final(fp);
 }
 
+void kptl_create_cmd_packet(frame_packet_t *fp, cmd_packet_t *cp, uint32_t *param)
+{
+    cp->param = param;
+    kptl_put_cmd(fp, cp->tag, cp->flags, cp->param_cnt, param);
+}
+
 uint32_t kptl_cmd_packet_get_size(cmd_packet_t *cp)
 {
     return 4 + cp->param_cnt*sizeof(uint32_t); 
@@ -89,29 +187,41 @@ uint32_t kptl_cmd_packet_get_size(cmd_packet_t *cp)
 uint32_t kptl_create_generic_resp_packet(frame_packet_t *fp, uint32_t status_code, uint32_t cmd_tag)
 {
     uint32_t param[2];
-    cmd_packet_t cp;
     
-    cp.tag = kCommandTag_GenericResponse;
-    cp.flags = 0x00;
-    cp.param_cnt = 2;
-    cp.reserved = 0x00;
+    param[0] = status_code;
+    param[1] = cmd_tag;
+    kptl_put_cmd(fp, kCommandTag_GenericResponse, 0x00, 2, param);
+
+    return CH_OK;
+}
+
+/* generic response with one extra parameter after status and command tag */
+uint32_t kptl_create_generic_resp_packet_ext(frame_packet_t *fp, uint32_t status_code, uint32_t cmd_tag, uint32_t value)
+{
+    uint32_t param[3];
     
     param[0] = status_code;
     param[1] = cmd_tag;
-    kptl_create_cmd_packet(fp, &cp, param);
+    param[2] = value;
+    kptl_put_cmd(fp, kCommandTag_GenericResponse, 0x00, 3, param);
 
     return CH_OK;
 }
 
-uint32_t kptl_create_property_resp_packet(frame_packet_t *p, uint8_t param_cnt, uint32_t *param)
+uint32_t kptl_create_read_memory_resp_packet(frame_packet_t *fp, uint32_t status_code, uint32_t byte_cnt)
 {
-    cmd_packet_t cp;
-    cp.tag = kCommandTag_GetPropertyResponse;
-    cp.flags = 0x00;
-    cp.reserved = 0x00;
-    cp.param_cnt = param_cnt;
+    uint32_t param[2];
+    
+    param[0] = status_code;
+    param[1] = byte_cnt;
+    kptl_put_cmd(fp, kCommandTag_ReadMemoryResponse, 0x00, 2, param);
 
-    kptl_create_cmd_packet(p, &cp, param);
+    return CH_OK;
+}
+
+uint32_t kptl_create_property_resp_packet(frame_packet_t *p, uint8_t param_cnt, uint32_t *param)
+{
+    kptl_put_cmd(p, kCommandTag_GetPropertyResponse, 0x00, param_cnt, param);
 
     return CH_OK;
 }
@@ -144,7 +254,7 @@ uint32_t kptl_frame_packet_begin(frame_packet_t *p, uint8_t frame_type)
     p->len[1] = 0;
     p->crc16[0] = 0;
     p->crc16[1] = 0;
-    memset(p->payload, 0, sizeof(p->payload));
+    /* payload is not cleared, only len bytes of it are sent */
     return CH_OK;
 }
 
@@ -163,6 +273,12 @@ uint32_t kptl_frame_packet_add(frame_packet_t *p, uint8_t *buf, uint16_t len)
 }
 
 uint32_t kptl_frame_packet_final(frame_packet_t *p)
+{
+    return kptl_frame_packet_final_ext(p, p->payload);
+}
+
+/* finalize a frame whose payload is sent from elsewhere (e.g. mapped flash), len must be set */
+uint32_t kptl_frame_packet_final_ext(frame_packet_t *p, const uint8_t *payload)
 {
     
     /* crc */
@@ -170,7 +286,7 @@ uint32_t kptl_frame_packet_final(frame_packet_t *p)
     crc = 0;
     crc16_update(&crc, (uint8_t*)&p->hr, 2);
     crc16_update(&crc, (uint8_t*)p->len, 2);
-    crc16_update(&crc, (uint8_t*)p->payload, ARRAY2INT16(p->len));
+    crc16_update(&crc, payload, ARRAY2INT16(p->len));
     
     p->crc16[0] = (crc & 0x00FF) >> 0;
     p->crc16[1] = (crc & 0xFF00) >> 8;
@@ -210,6 +326,14 @@ int kptl_decode_init(pkt_dec_t *d)
 {
     d->cnt = 0;
     d->status = kStatus_Idle;
+    if(d->ring)
+    {
+        d->head = 0;
+        d->tail = 0;
+        d->overflow_cnt = 0;
+        d->nak_cnt = 0;
+        d->fp = &d->ring[0];
+    }
     if(!d->fp)
     {
         return 1;
@@ -218,7 +342,73 @@ int kptl_decode_init(pkt_dec_t *d)
     return 0;
 }
 
-#define SAFE_CALL_CB    if(d->cb) d->cb(p)
+/* a frame is complete: publish it to the ring if there is one, then notify */
+static void kptl_frame_done(pkt_dec_t *d, frame_packet_t *p)
+{
+    uint32_t next;
+    
+    if(d->get_tick)
+    {
+        p->rx_tick = d->get_tick();
+    }
+    
+    if(d->ring)
+    {
+        next = (d->head + 1) % d->ring_size;
+        if(next == d->tail)
+        {
+            /* ring full, drop it and decode the next frame into the same slot.
+               host waits for the ACK of a command or data frame, it gets a NAK and sends it again */
+            d->overflow_cnt++;
+            if((p->hr.packet_type == kFramingPacketType_Command) || (p->hr.packet_type == kFramingPacketType_Data))
+            {
+                d->nak_cnt++;
+            }
+            return;
+        }
+        KPTL_BARRIER();
+        d->head = next;
+        d->fp = &d->ring[next];
+    }
+    
+    if(d->cb)
+    {
+        d->cb(p);
+    }
+}
+
+/* get the oldest received frame, NULL if none */
+frame_packet_t *kptl_ring_peek(pkt_dec_t *d)
+{
+    if(d->tail == d->head)
+    {
+        return NULL;
+    }
+    KPTL_BARRIER();
+    return &d->ring[d->tail];
+}
+
+/* frame i places behind the oldest one, NULL if fewer are queued. it stays queued */
+frame_packet_t *kptl_ring_peek_at(pkt_dec_t *d, uint32_t i)
+{
+    uint32_t head = d->head;
+    
+    if(i >= (head + d->ring_size - d->tail) % d->ring_size)
+    {
+        return NULL;
+    }
+    KPTL_BARRIER();
+    return &d->ring[(d->tail + i) % d->ring_size];
+}
+
+/* done with the frame returned by kptl_ring_peek, give the slot back to the decoder */
+void kptl_ring_release(pkt_dec_t *d)
+{
+    KPTL_BARRIER();
+    d->tail = (d->tail + 1) % d->ring_size;
+}
+
+#define SAFE_CALL_CB    kptl_frame_done(d, p)
     
  /**
  * @brief  decode any type of packet
@@ -230,7 +420,6 @@ int kptl_decode_init(pkt_dec_t *d)
 uint32_t kptl_decode(pkt_dec_t *d, uint8_t c)
 {
     int ret = CH_ERR;
-    uint16_t crc_calculated = 0;          /* CRC value caluated from a frame */
     frame_packet_t *p = d->fp;
     uint8_t *payload_buf = (uint8_t*)d->fp->payload;
     
@@ -248,9 +437,10 @@ uint32_t kptl_decode(pkt_dec_t *d, uint8_t c)
             switch(c)
             {
                 case kFramingPacketType_Command:
-                    d->status = kStatus_LenLow;
-                    break;
                 case kFramingPacketType_Data:
+                    /* CRC runs along with reception: header, length, payload */
+                    d->crc = 0;
+                    crc16_update(&d->crc, (uint8_t*)&p->hr, 2);
                     d->status = kStatus_LenLow;
                     break;
                 case kFramingPacketType_Ping:
@@ -273,11 +463,13 @@ uint32_t kptl_decode(pkt_dec_t *d, uint8_t c)
             break;
         case kStatus_LenLow:
             p->len[0] = c;
+            crc16_update(&d->crc, &c, 1);
             d->status = kStatus_LenHigh;
             break;
         case kStatus_LenHigh:
             p->len[1] = c;
-            if(ARRAY2INT16(p->len) <= MAX_PACKET_LEN)
+            crc16_update(&d->crc, &c, 1);
+            if(ARRAY2INT16(p->len) <= ((d->max_len)?(d->max_len):(MAX_PACKET_LEN)))
             {
                 d->status = kStatus_CRCLow;
             }
@@ -298,15 +490,15 @@ uint32_t kptl_decode(pkt_dec_t *d, uint8_t c)
         case kStatus_Data:
             payload_buf[d->cnt++] = c;
                    
+            if(p->hr.packet_type == kFramingPacketType_Command || p->hr.packet_type == kFramingPacketType_Data)
+            {
+                crc16_update(&d->crc, &c, 1);
+            }
+            
             if((p->hr.packet_type == kFramingPacketType_Command || p->hr.packet_type == kFramingPacketType_Data) && d->cnt >= ARRAY2INT16(p->len))
             {
-                /* calculate CRC */
-                crc_calculated = 0;
-                crc16_update(&crc_calculated, (uint8_t*)&p->hr, 2);
-                crc16_update(&crc_calculated, p->len, 2);
-                crc16_update(&crc_calculated, payload_buf, d->cnt);
                 /* CRC match */
-                if(crc_calculated == ARRAY2INT16(p->crc16))
+                if(d->crc == ARRAY2INT16(p->crc16))
                 {
                     SAFE_CALL_CB;
                     ret = CH_OK;
@@ -330,3 +522,38 @@ uint32_t kptl_decode(pkt_dec_t *d, uint8_t c)
     return ret;
 }
 
+ /**
+ * @brief  decode a received batch
+ * @note   payload runs of command and data frames are copied and CRCed in one go,
+ *         everything else goes through kptl_decode byte by byte
+ * @param  d: decode handle, buf: received bytes, len: length of buf
+ * @retval None
+ */
+void kptl_decode_buf(pkt_dec_t *d, const uint8_t *buf, uint32_t len)
+{
+    frame_packet_t *p;
+    uint32_t n, i = 0;
+    
+    while(i < len)
+    {
+        p = d->fp;
+        if(d->status == kStatus_Data && d->cnt + 1 < ARRAY2INT16(p->len) &&
+            (p->hr.packet_type == kFramingPacketType_Command || p->hr.packet_type == kFramingPacketType_Data))
+        {
+            /* all but the last payload byte, the last one completes the frame below */
+            n = ARRAY2INT16(p->len) - d->cnt - 1;
+            if(n > len - i)
+            {
+                n = len - i;
+            }
+            memcpy(&p->payload[d->cnt], &buf[i], n);
+            crc16_update(&d->crc, &buf[i], n);
+            d->cnt += n;
+            i += n;
+        }
+        else
+        {
+            kptl_decode(d, buf[i++]);
+        }
+    }
+}
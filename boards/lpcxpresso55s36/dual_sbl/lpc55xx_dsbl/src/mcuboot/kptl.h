@@ -11,10 +11,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* largest frame payload, sizes every frame buffer. 1K-4K cuts WriteMemory round trips when RAM permits */
+#ifndef MAX_PACKET_LEN
 #define MAX_PACKET_LEN          (512)
+#endif
+
+/* WriteMemory programs each data packet on its own and pads its last flash page with erased value,
+   a page is programmed only once, so every packet but the last must end on a page boundary */
+#define KPTL_PACKET_ALIGN       (512)
+
+#if (MAX_PACKET_LEN < KPTL_PACKET_ALIGN) || (MAX_PACKET_LEN > 0xFFFF) || (MAX_PACKET_LEN % KPTL_PACKET_ALIGN)
+#error "MAX_PACKET_LEN must be a multiple of 512 up to 65024"
+#endif
+
+/* CRC16 of framing: 0: bitwise, 1: 256 entry table,
+   2: CRC engine (also used for image CRC32, caller must not interleave the two) */
+#ifndef KPTL_CRC16_IMPL
+#define KPTL_CRC16_IMPL         (1)
+#endif
 
 
-#define ARRAY2INT16(x)     (x[0] + (x[1] << 8))
+#define ARRAY2INT16(x)     ((uint32_t)x[0] + ((uint32_t)x[1] << 8))
+
+/* compiler barrier between frame data and ring index updates */
+#ifndef KPTL_BARRIER
+#if defined(__GNUC__) || defined(__ARMCC_VERSION) || defined(__ICCARM__)
+#define KPTL_BARRIER()     __asm volatile("" ::: "memory")
+#else
+#define KPTL_BARRIER()
+#endif
+#endif
 
 /* header include start_byte and type */
 typedef struct
@@ -29,6 +55,7 @@ typedef struct
     uint8_t         len[2];
     uint8_t         crc16[2];
     uint8_t         payload[MAX_PACKET_LEN];
+    uint32_t        rx_tick;        /* not on the wire: decoder tick when the frame completed */
 }frame_packet_t;
 
 typedef struct
@@ -37,6 +64,18 @@ typedef struct
     uint32_t         cnt;
     void (*cb)(frame_packet_t *pkt);
     uint8_t          status;
+    uint16_t         crc;               /* running CRC of the frame being decoded */
+    uint16_t         max_len;           /* runtime payload limit, 0: MAX_PACKET_LEN */
+    uint32_t (*get_tick)(void);         /* optional, stamps fp->rx_tick */
+    
+    /* optional receive ring, decoder(ISR) is the only producer, main loop the only consumer.
+       the slot at head is being decoded, so ring_size - 1 frames can be queued */
+    frame_packet_t*  ring;
+    uint32_t         ring_size;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t         overflow_cnt;      /* completed frames dropped because ring was full */
+    volatile uint32_t nak_cnt;          /* dropped command and data frames, consumer answers each with a NAK */
 }pkt_dec_t;
 
 /* ping packet, ack packet, nak packet are only contain 2 bytes */
@@ -104,6 +143,8 @@ enum
     kCommandTag_FlashReadResourceResponse   = 0xb0,
     kCommandTag_ConfigureQuadSpi            = 0x11,
 
+    kCommandTag_FlashCrc32                  = 0x20,     //!< vendor: CRC32 of a memory range, digest in generic response
+
     kFirstCommandTag                    = kCommandTag_FlashEraseAll,
 
     //! Maximum linearly incrementing command tag value, excluding the response commands.
@@ -116,11 +157,14 @@ enum
 uint32_t kptl_frame_packet_add(frame_packet_t *pkt, uint8_t *buf, uint16_t len);
 uint32_t kptl_frame_packet_begin(frame_packet_t *pkt, uint8_t type);
 uint32_t kptl_frame_packet_final(frame_packet_t *pkt);
+uint32_t kptl_frame_packet_final_ext(frame_packet_t *p, const uint8_t *payload);
 uint32_t kptl_frame_packet_get_size(frame_packet_t *p);
 
 /* resp packet, resp packet is a speical form of command packet */
 uint32_t kptl_create_generic_resp_packet(frame_packet_t *pkt, uint32_t status_code, uint32_t cmd_tag);
+uint32_t kptl_create_generic_resp_packet_ext(frame_packet_t *fp, uint32_t status_code, uint32_t cmd_tag, uint32_t value);
 uint32_t kptl_create_property_resp_packet(frame_packet_t *p, uint8_t param_cnt, uint32_t *param);
+uint32_t kptl_create_read_memory_resp_packet(frame_packet_t *fp, uint32_t status_code, uint32_t byte_cnt);
 
 /* command packet, command packet must be waprred in frame packet */
 void kptl_create_cmd_packet(frame_packet_t *fp, cmd_packet_t *cp, uint32_t *param);
@@ -135,6 +179,10 @@ void kptl_create_ping_resp_packet(ping_resp_packet_t *p, uint8_t major, uint8_t
 /* packet decode API */
 int kptl_decode_init(pkt_dec_t *d);
 uint32_t kptl_decode(pkt_dec_t *d, uint8_t c);
+void kptl_decode_buf(pkt_dec_t *d, const uint8_t *buf, uint32_t len);
+frame_packet_t *kptl_ring_peek(pkt_dec_t *d);
+frame_packet_t *kptl_ring_peek_at(pkt_dec_t *d, uint32_t i);
+void kptl_ring_release(pkt_dec_t *d);
 void crc16_update(uint16_t *currectCrc, const uint8_t *src, uint32_t lengthInBytes);
 
 #endif
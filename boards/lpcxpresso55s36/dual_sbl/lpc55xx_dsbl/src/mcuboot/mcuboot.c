@@ -8,7 +8,217 @@
 #include "mcuboot.h"
 #include <string.h>
 
-static int evt = 0;
+/* packet type of a ring slot already answered, not a framing type */
+#define MCUBOOT_FRAME_SERVED    (0x00)
+
+/* program a data packet, after the first error the rest of the WriteMemory is dropped */
+static void write_data(mcuboot_t *ctx, uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    int ret;
+    
+    if(ctx->wr_status == 0)
+    {
+        ret = ctx->op_mem_write(addr, buf, len);
+        ctx->wr_status = (ret)?((uint32_t)ret):(MCUBOOT_STATUS_SUCCESS);
+    }
+}
+
+#if (MCUBOOT_PIPELINE_WRITE)
+/* program the oldest buffered data packet */
+static void write_flush_one(mcuboot_t *ctx)
+{
+    mcuboot_wr_buf_t *b;
+    
+    if(ctx->wr_cnt)
+    {
+        b = &ctx->wr_buf[ctx->wr_tail];
+        write_data(ctx, b->addr, b->data, b->len);
+        ctx->wr_tail = (ctx->wr_tail + 1) % MCUBOOT_WR_BUF_CNT;
+        ctx->wr_cnt--;
+    }
+}
+
+static void write_flush_all(mcuboot_t *ctx)
+{
+    while(ctx->wr_cnt)
+    {
+        write_flush_one(ctx);
+    }
+}
+#endif
+
+/* range lies in the configured flash or RAM window */
+static int mem_in_window(mcuboot_t *ctx, uint32_t addr, uint32_t len)
+{
+    if((len <= ctx->cfg_flash_size) && (addr >= ctx->cfg_flash_start) && (addr - ctx->cfg_flash_start <= ctx->cfg_flash_size - len))
+    {
+        return 1;
+    }
+    
+    if((len <= ctx->cfg_ram_size) && (addr >= ctx->cfg_ram_start) && (addr - ctx->cfg_ram_start <= ctx->cfg_ram_size - len))
+    {
+        return 1;
+    }
+    
+    return 0;
+}
+
+/* FillMemory: repeat a 32 bit pattern over a range, flash is written through op_mem_write */
+static uint32_t fill_memory(mcuboot_t *ctx, uint32_t addr, uint32_t len, uint32_t pattern)
+{
+    uint8_t *buf;
+    uint32_t i, n;
+    
+    /* RAM: fill in place */
+    if((addr >= ctx->cfg_ram_start) && (addr - ctx->cfg_ram_start < ctx->cfg_ram_size))
+    {
+        buf = (uint8_t *)(uintptr_t)addr;
+        for(i=0; i<len; i++)
+        {
+            buf[i] = (pattern >> (8*(i & 0x3))) & 0xFF;
+        }
+        return MCUBOOT_STATUS_SUCCESS;
+    }
+    
+    /* flash: pattern buffer in tx frame, offsets stay 4 byte aligned between chunks */
+    buf = ctx->tx_pkt.payload;
+    n = (len > MAX_PACKET_LEN)?(MAX_PACKET_LEN):(len);
+    for(i=0; i<n; i++)
+    {
+        buf[i] = (pattern >> (8*(i & 0x3))) & 0xFF;
+    }
+    
+    while(len)
+    {
+        n = (len > MAX_PACKET_LEN)?(MAX_PACKET_LEN):(len);
+        if(ctx->op_mem_write(addr, buf, n) != 0)
+        {
+            return MCUBOOT_STATUS_FAIL;
+        }
+        addr += n;
+        len -= n;
+    }
+    return MCUBOOT_STATUS_SUCCESS;
+}
+
+/* send next ReadMemory data frame, the payload goes out straight from memory when it can be accessed in place */
+static void read_send_chunk(mcuboot_t *ctx)
+{
+    const uint8_t *src = NULL;
+    uint32_t n;
+    
+    n = (ctx->rd_remain > ctx->cfg_max_packet_len)?(ctx->cfg_max_packet_len):(ctx->rd_remain);
+    
+    if((ctx->rd_addr >= ctx->cfg_ram_start) && (ctx->rd_addr - ctx->cfg_ram_start < ctx->cfg_ram_size))
+    {
+        src = (const uint8_t *)(uintptr_t)ctx->rd_addr;
+    }
+    else if(ctx->op_mem_map)
+    {
+        src = ctx->op_mem_map(ctx->rd_addr, n);
+    }
+    
+    if(!src)
+    {
+        /* not readable in place (e.g. erased page), copy through tx frame, unreadable data reads as erased */
+        if((!ctx->op_mem_read) || (ctx->op_mem_read(ctx->rd_addr, ctx->tx_pkt.payload, n) != 0))
+        {
+            memset(ctx->tx_pkt.payload, 0xFF, n);
+        }
+        src = ctx->tx_pkt.payload;
+    }
+    
+    kptl_frame_packet_begin(&ctx->tx_pkt, kFramingPacketType_Data);
+    ctx->tx_pkt.len[0] = (n >> 0) & 0xFF;
+    ctx->tx_pkt.len[1] = (n >> 8) & 0xFF;
+    kptl_frame_packet_final_ext(&ctx->tx_pkt, src);
+    
+    /* frame header, then payload */
+    ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt) - n);
+    ctx->op_send((uint8_t*)src, n);
+    
+    ctx->rd_chunk = n;
+    ctx->rd_state = kMcuboot_ReadWaitDataAck;
+}
+
+/* ReadMemoryResponse, the data phase starts when the host acks it */
+static void read_send_resp(mcuboot_t *ctx)
+{
+    kptl_create_read_memory_resp_packet(&ctx->tx_pkt, MCUBOOT_STATUS_SUCCESS, ctx->rd_remain);
+    ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+    ctx->rd_state = kMcuboot_ReadWaitRespAck;
+}
+
+/* host acked (or nacked) the last frame of ReadMemory */
+static void read_proc(mcuboot_t *ctx, uint8_t packet_type)
+{
+    switch(ctx->rd_state)
+    {
+        case kMcuboot_ReadWaitRespAck:
+            if(packet_type == kFramingPacketType_Nak)
+            {
+                /* resend the response */
+                read_send_resp(ctx);
+                break;
+            }
+            read_send_chunk(ctx);
+            break;
+        case kMcuboot_ReadWaitDataAck:
+            if(packet_type == kFramingPacketType_Nak)
+            {
+                /* resend same chunk */
+                read_send_chunk(ctx);
+                break;
+            }
+            
+            ctx->rd_addr += ctx->rd_chunk;
+            ctx->rd_remain -= ctx->rd_chunk;
+            if(ctx->rd_remain)
+            {
+                read_send_chunk(ctx);
+            }
+            else
+            {
+                kptl_create_generic_resp_packet(&ctx->tx_pkt, MCUBOOT_STATUS_SUCCESS, kCommandTag_ReadMemory);
+                ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+                ctx->rd_state = kMcuboot_ReadWaitFinalAck;
+            }
+            break;
+        case kMcuboot_ReadWaitFinalAck:
+            ctx->rd_state = kMcuboot_ReadIdle;
+            break;
+        default:
+            break;
+    }
+}
+
+/* drive a non-blocking FlashEraseRegion, send its response once finished */
+static void erase_proc(mcuboot_t *ctx)
+{
+    int ret;
+    
+    ret = ctx->op_mem_erase_poll(&ctx->erase_done);
+    if(ret < 0)
+    {
+        return;
+    }
+    
+    ctx->erase_active = 0;
+    kptl_create_generic_resp_packet(&ctx->tx_pkt, (ret == 0)?(MCUBOOT_STATUS_SUCCESS):(MCUBOOT_STATUS_FAIL), kCommandTag_FlashEraseRegion);
+    ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+}
+
+static void stat_ack(mcuboot_t *ctx, frame_packet_t *pkt)
+{
+    if(ctx->op_get_tick)
+    {
+        ctx->stat_ack_latency = ctx->op_get_tick() - pkt->rx_tick;
+        if(ctx->stat_ack_latency > ctx->stat_ack_latency_max)
+        {
+            ctx->stat_ack_latency_max = ctx->stat_ack_latency;
+        }
+    }
+}
 
 static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
 {
@@ -25,9 +235,25 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
     /* reply ack */
     kptl_create_ack(&ack);
     ctx->op_send((uint8_t*)&ack, sizeof(ack));
+    stat_ack(ctx, pkt);
+    
+    /* a new command ends any pending data phase */
+    ctx->rd_state = kMcuboot_ReadIdle;
     
     switch(rx_cp.tag)
     {
+        case kCommandTag_ReadMemory:
+            ctx->rd_addr = rx_cp.param[0];
+            ctx->rd_remain = rx_cp.param[1];
+            if((rx_cp.param_cnt < 2) || (ctx->rd_remain == 0) || (!mem_in_window(ctx, ctx->rd_addr, ctx->rd_remain)))
+            {
+                kptl_create_generic_resp_packet(&ctx->tx_pkt, MCUBOOT_STATUS_MEMORY_RANGE_INVALID, kCommandTag_ReadMemory);
+                ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+                break;
+            }
+            
+            read_send_resp(ctx);
+            break;
         case kCommandTag_GetProperty:
             tx_param[0] = 0x00000000;
             switch(rx_cp.param[0])
@@ -57,7 +283,7 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
                     tx_param_cnt = 2;
                     break;
                 case 0x0B:  /* MaxPacketSize */
-                    tx_param[1] = MAX_PACKET_LEN;
+                    tx_param[1] = ctx->cfg_max_packet_len;
                     tx_param_cnt = 2;
                     break;
                 case 0x10:  /* device id */
@@ -68,6 +294,11 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
                     tx_param[1] = ctx->cfg_uuid;
                     tx_param_cnt = 2;
                     break;
+                case MCUBOOT_PROP_ERASE_PROGRESS:
+                    tx_param[1] = (ctx->erase_active)?(ctx->erase_done):(ctx->erase_len);
+                    tx_param[2] = ctx->erase_len;
+                    tx_param_cnt = 3;
+                    break;
                 default:
                     /* not supported */
                     break;
@@ -76,11 +307,75 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
             kptl_create_property_resp_packet(&ctx->tx_pkt, tx_param_cnt, tx_param);
             ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
             break;
+        case kCommandTag_FillMemory:
+        {
+            uint32_t status = MCUBOOT_STATUS_MEMORY_RANGE_INVALID;
+            
+            if((rx_cp.param_cnt >= 3) && mem_in_window(ctx, rx_cp.param[0], rx_cp.param[1]))
+            {
+                status = fill_memory(ctx, rx_cp.param[0], rx_cp.param[1], rx_cp.param[2]);
+            }
+            
+            kptl_create_generic_resp_packet(&ctx->tx_pkt, status, kCommandTag_FillMemory);
+            ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+            break;
+        }
+        case kCommandTag_FlashCrc32:
+        {
+            uint32_t crc = 0;
+            uint32_t status = MCUBOOT_STATUS_MEMORY_RANGE_INVALID;
+            
+            /* host verifies written data by digest instead of reading it back */
+            if((rx_cp.param_cnt >= 2) && ctx->op_mem_crc32 && mem_in_window(ctx, rx_cp.param[0], rx_cp.param[1]))
+            {
+                status = (ctx->op_mem_crc32(rx_cp.param[0], rx_cp.param[1], &crc) == 0)?(MCUBOOT_STATUS_SUCCESS):(MCUBOOT_STATUS_FAIL);
+                crc = (status == MCUBOOT_STATUS_SUCCESS)?(crc):(0);
+            }
+            
+            kptl_create_generic_resp_packet_ext(&ctx->tx_pkt, status, kCommandTag_FlashCrc32, crc);
+            ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+            break;
+        }
+        case kCommandTag_SetProperty:
+        {
+            uint32_t status = MCUBOOT_STATUS_UNKNOWN_PROPERTY;
+            
+            if((rx_cp.param[0] == MCUBOOT_PROP_UART_BAUD) && ctx->op_set_baud)
+            {
+                /* a rate the UART can not reach is refused before the host switches */
+                status = ((rx_cp.param_cnt >= 2) && rx_cp.param[1] && (!ctx->op_check_baud || (ctx->op_check_baud(rx_cp.param[1]) == 0)))?
+                         (MCUBOOT_STATUS_SUCCESS):(MCUBOOT_STATUS_INVALID_PROPERTY_VALUE);
+            }
+            
+            kptl_create_generic_resp_packet(&ctx->tx_pkt, status, kCommandTag_SetProperty);
+            ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
+            
+            /* response goes out at the old rate, host pings at the new one */
+            if((status == MCUBOOT_STATUS_SUCCESS) && (ctx->op_set_baud(rx_cp.param[1]) == 0) && ctx->op_get_tick)
+            {
+                ctx->baud_pending = 1;
+                ctx->baud_start = ctx->op_get_tick();
+            }
+            break;
+        }
         case kCommandTag_FlashEraseRegion:
-            ctx->mem_start_addr = rx_cp.param[0];
-            ctx->mem_len = rx_cp.param[1];
-            ctx->op_mem_erase(ctx->mem_start_addr, ctx->mem_len);
-            kptl_create_generic_resp_packet(&ctx->tx_pkt, 0, kCommandTag_FlashEraseRegion);
+            ctx->erase_len = rx_cp.param[1];
+            if(ctx->op_mem_erase_start)
+            {
+                /* response is sent by erase_proc when done */
+                ctx->erase_done = 0;
+                if(ctx->op_mem_erase_start(rx_cp.param[0], ctx->erase_len) == 0)
+                {
+                    ctx->erase_active = 1;
+                    break;
+                }
+                kptl_create_generic_resp_packet(&ctx->tx_pkt, MCUBOOT_STATUS_FAIL, kCommandTag_FlashEraseRegion);
+            }
+            else
+            {
+                ctx->op_mem_erase(rx_cp.param[0], ctx->erase_len);
+                kptl_create_generic_resp_packet(&ctx->tx_pkt, 0, kCommandTag_FlashEraseRegion);
+            }
             ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
             break;
         case kCommandTag_FlashEraseAll: /* not support */
@@ -91,6 +386,11 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
             ctx->mem_start_addr = rx_cp.param[0];
             ctx->mem_len = rx_cp.param[1];
             ctx->mem_cur_addr = ctx->mem_start_addr;
+            ctx->wr_status = MCUBOOT_STATUS_SUCCESS;
+            if(ctx->op_get_tick)
+            {
+                ctx->stat_write_start = ctx->op_get_tick();
+            }
 
             kptl_create_generic_resp_packet(&ctx->tx_pkt, 0x00000000, kCommandTag_WriteMemory);
             ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
@@ -118,16 +418,50 @@ static void handle_cmd(mcuboot_t *ctx, frame_packet_t *pkt)
     }
 }
 
-static void dec_cb(frame_packet_t *rx)
+/* frames served while erasing: ping and GetProperty (progress) from anywhere in the ring,
+   ACK and data only at its head, other commands wait there */
+static int erase_serves(frame_packet_t *pkt, uint32_t pos)
 {
-    evt = 1;
+    switch(pkt->hr.packet_type)
+    {
+        case kFramingPacketType_Ping:
+            return 1;
+        case kFramingPacketType_Command:
+            return (pkt->payload[0] == kCommandTag_GetProperty);
+        default:
+            return (pos == 0);
+    }
 }
 
 void mcuboot_proc(mcuboot_t *ctx)
 {
-    if(evt)
+    frame_packet_t *pkt;
+    uint32_t pos = 0;
+    
+    if(ctx->erase_active)
+    {
+        erase_proc(ctx);
+    }
+    
+    /* frames answered ahead of a waiting command leave once they reach the head */
+    while(((pkt = kptl_ring_peek(&ctx->dec)) != NULL) && (pkt->hr.packet_type == MCUBOOT_FRAME_SERVED))
     {
-        switch(ctx->rx_pkt.hr.packet_type)
+        kptl_ring_release(&ctx->dec);
+    }
+    
+    if(ctx->erase_active)
+    {
+        for(pos=0; ((pkt = kptl_ring_peek_at(&ctx->dec, pos)) != NULL) && ((pkt->hr.packet_type == MCUBOOT_FRAME_SERVED) || !erase_serves(pkt, pos)); pos++)
+        {
+        }
+    }
+    
+    if(pkt)
+    {
+        /* host talks at the new rate */
+        ctx->baud_pending = 0;
+        
+        switch(pkt->hr.packet_type)
         {
             case kFramingPacketType_Ping:
             {
@@ -136,9 +470,17 @@ void mcuboot_proc(mcuboot_t *ctx)
                 ctx->op_send((uint8_t*)&pr, sizeof(ping_resp_packet_t));
                 break;
             }
+            case kFramingPacketType_Ack:
+            case kFramingPacketType_Nak:
+                read_proc(ctx, pkt->hr.packet_type);
+                break;
             case kFramingPacketType_Command:
             {
-                handle_cmd(ctx, &ctx->rx_pkt);
+#if (MCUBOOT_PIPELINE_WRITE)
+                /* finish pending writes before any command */
+                write_flush_all(ctx);
+#endif
+                handle_cmd(ctx, pkt);
                 break;
             }
 
@@ -147,20 +489,52 @@ void mcuboot_proc(mcuboot_t *ctx)
                 packet_ack_t ack;
     
                 int len;
-                len = ARRAY2INT16(ctx->rx_pkt.len);
+                len = ARRAY2INT16(pkt->len);
+                
+#if (MCUBOOT_PIPELINE_WRITE)
+                mcuboot_wr_buf_t *b;
+                
+                /* all buffers are full, wait for the oldest one */
+                if(ctx->wr_cnt == MCUBOOT_WR_BUF_CNT)
+                {
+                    write_flush_one(ctx);
+                }
                 
-                ctx->op_mem_write(ctx->mem_cur_addr, ctx->rx_pkt.payload, len);
+                /* buffer it, programmed after ack */
+                b = &ctx->wr_buf[ctx->wr_head];
+                b->addr = ctx->mem_cur_addr;
+                b->len = len;
+                memcpy(b->data, pkt->payload, len);
+                ctx->wr_head = (ctx->wr_head + 1) % MCUBOOT_WR_BUF_CNT;
+                ctx->wr_cnt++;
+#else
+                write_data(ctx, ctx->mem_cur_addr, pkt->payload, len);
+#endif
                 ctx->mem_cur_addr += len;
                 
                 /* reply ack */
                 kptl_create_ack(&ack);
                 ctx->op_send((uint8_t*)&ack, sizeof(ack));
+                stat_ack(ctx, pkt);
                 
                 /* send final generic resp packet */
                 
                 if(ctx->mem_cur_addr >= (ctx->mem_start_addr + ctx->mem_len))
                 {
-                    kptl_create_generic_resp_packet(&ctx->tx_pkt, 0x00000000, kCommandTag_WriteMemory);
+#if (MCUBOOT_PIPELINE_WRITE)
+                    write_flush_all(ctx);
+#endif
+                    if(ctx->op_get_tick)
+                    {
+                        ctx->stat_write_ticks = ctx->op_get_tick() - ctx->stat_write_start;
+                        if(ctx->stat_write_ticks)
+                        {
+                            ctx->stat_write_bps = (uint64_t)ctx->mem_len * ctx->cfg_tick_freq / ctx->stat_write_ticks;
+                        }
+                    }
+                    
+                    /* packets are ACKed before they are programmed, a program failure shows here only */
+                    kptl_create_generic_resp_packet(&ctx->tx_pkt, ctx->wr_status, kCommandTag_WriteMemory);
                     ctx->op_send((uint8_t*)&ctx->tx_pkt, kptl_frame_packet_get_size(&ctx->tx_pkt));
                     
                     /* callback: complete */
@@ -169,25 +543,74 @@ void mcuboot_proc(mcuboot_t *ctx)
                 break;
             }
         }
-        evt = 0;
+        
+        if(pos == 0)
+        {
+            kptl_ring_release(&ctx->dec);
+        }
+        else
+        {
+            /* behind a waiting command, the slot is freed in order */
+            pkt->hr.packet_type = MCUBOOT_FRAME_SERVED;
+        }
+    }
+    else if((ctx->nak_sent != ctx->dec.nak_cnt) && !kptl_ring_peek(&ctx->dec))
+    {
+        /* frames queued ahead of a dropped one are answered, ask the host to send it again */
+        packet_nak_t nak;
+        
+        kptl_create_nak(&nak);
+        ctx->op_send((uint8_t*)&nak, sizeof(nak));
+        ctx->nak_sent++;
+    }
+#if (MCUBOOT_PIPELINE_WRITE)
+    else
+    {
+        /* nothing received, program a buffered packet while the next one arrives */
+        write_flush_one(ctx);
+    }
+#endif
+    
+    /* nothing heard after a baud rate change, go back to the default rate */
+    if(ctx->baud_pending && ((ctx->op_get_tick() - ctx->baud_start) > (ctx->cfg_tick_freq / 1000) * MCUBOOT_BAUD_TIMEOUT_MS))
+    {
+        ctx->baud_pending = 0;
+        ctx->op_set_baud(ctx->cfg_uart_baud);
     }
 }
 
 void mcuboot_recv(mcuboot_t *ctx, uint8_t *buf, uint32_t len)
 {
-    int i;
-    
-    for(i=0; i<len; i++)
-    {
-        kptl_decode(&ctx->dec, buf[i]);
-    }
+    kptl_decode_buf(&ctx->dec, buf, len);
 }
 
 void mcuboot_init(mcuboot_t *ctx)
 {
-    ctx->dec.fp = &ctx->rx_pkt;
-    ctx->dec.cb = dec_cb;
+    ctx->dec.ring = ctx->rx_slot;
+    ctx->dec.ring_size = MCUBOOT_RX_SLOT_CNT;
+    ctx->dec.cb = NULL;
+    ctx->dec.get_tick = ctx->op_get_tick;
+    if((ctx->cfg_max_packet_len == 0) || (ctx->cfg_max_packet_len > MAX_PACKET_LEN))
+    {
+        ctx->cfg_max_packet_len = MAX_PACKET_LEN;
+    }
+    
+    /* whole flash pages per packet, see KPTL_PACKET_ALIGN */
+    ctx->cfg_max_packet_len -= ctx->cfg_max_packet_len % KPTL_PACKET_ALIGN;
+    if(ctx->cfg_max_packet_len == 0)
+    {
+        ctx->cfg_max_packet_len = KPTL_PACKET_ALIGN;
+    }
+    ctx->dec.max_len = ctx->cfg_max_packet_len;
+    ctx->baud_pending = 0;
+    ctx->rd_state = kMcuboot_ReadIdle;
+    ctx->erase_active = 0;
     kptl_decode_init(&ctx->dec);
-    evt = 0;
+    ctx->nak_sent = 0;
+#if (MCUBOOT_PIPELINE_WRITE)
+    ctx->wr_head = 0;
+    ctx->wr_tail = 0;
+    ctx->wr_cnt = 0;
+#endif
 }
 
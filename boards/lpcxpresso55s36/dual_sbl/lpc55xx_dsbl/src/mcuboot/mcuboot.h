@@ -14,11 +14,55 @@
 
 #include "kptl.h"
 
+/* 1: ack a data packet once it is buffered and program it while the next one is received */
+#ifndef MCUBOOT_PIPELINE_WRITE
+#define MCUBOOT_PIPELINE_WRITE  (1)
+#endif
+
+/* number of receive ring slots, one is always in use by the decoder */
+#define MCUBOOT_RX_SLOT_CNT     (4)
+
+/* number of data packet buffers waiting to be programmed */
+#define MCUBOOT_WR_BUF_CNT      (2)
+
+/* SetProperty tag of the UART baud rate (vendor range) */
+#define MCUBOOT_PROP_UART_BAUD          (0xF0)
+
+/* GetProperty tag of FlashEraseRegion progress (vendor range): bytes done, bytes total */
+#define MCUBOOT_PROP_ERASE_PROGRESS     (0xF1)
+
+/* after a baud rate change, fall back to cfg_uart_baud if no packet arrives in time */
+#define MCUBOOT_BAUD_TIMEOUT_MS         (1000)
+
+/* MCUBOOT status codes of generic response */
+#define MCUBOOT_STATUS_SUCCESS                  (0)
+#define MCUBOOT_STATUS_FAIL                     (1)
+#define MCUBOOT_STATUS_MEMORY_RANGE_INVALID     (10200)
+#define MCUBOOT_STATUS_UNKNOWN_PROPERTY         (10300)
+#define MCUBOOT_STATUS_INVALID_PROPERTY_VALUE   (10302)
+
+/* ReadMemory data phase, each step waits for the host's ACK */
+enum
+{
+    kMcuboot_ReadIdle = 0,
+    kMcuboot_ReadWaitRespAck,       /* ReadMemoryResponse sent */
+    kMcuboot_ReadWaitDataAck,       /* data frame sent */
+    kMcuboot_ReadWaitFinalAck,      /* final generic response sent */
+};
+
+/* data packet waiting to be programmed */
+typedef struct
+{
+    uint32_t addr;
+    uint32_t len;
+    uint8_t  data[MAX_PACKET_LEN];
+}mcuboot_wr_buf_t;
+
 typedef struct
 {
     /* packet handing resource */
     pkt_dec_t dec;
-    frame_packet_t rx_pkt;
+    frame_packet_t rx_slot[MCUBOOT_RX_SLOT_CNT];
     frame_packet_t tx_pkt;
     
     /* transmit callback */
@@ -37,14 +81,51 @@ typedef struct
     int (*op_mem_write)(uint32_t addr, uint8_t* buf, uint32_t len);
     int (*op_mem_erase)(uint32_t addr, uint32_t len);
     int (*op_mem_read)(uint32_t addr, uint8_t* buf, uint32_t len);
+    int (*op_mem_erase_start)(uint32_t addr, uint32_t len);     /* optional, non-blocking erase, 0: started */
+    int (*op_mem_erase_poll)(uint32_t *done);                   /* < 0 while erasing, then 0 or error */
+    const uint8_t *(*op_mem_map)(uint32_t addr, uint32_t len);  /* optional, flash range readable in place or NULL */
+    int (*op_mem_crc32)(uint32_t addr, uint32_t len, uint32_t *crc);  /* optional, CRC32 of a range for FlashCrc32, 0: ok */
     void(*op_reset)(void);
     void(*op_jump)(uint32_t addr, uint32_t arg, uint32_t sp);
     void(*op_complete)(void);
+    uint32_t (*op_get_tick)(void);  /* optional, free running tick counter for statistics */
+    uint32_t cfg_tick_freq;         /* op_get_tick frequency in Hz */
+    int (*op_set_baud)(uint32_t baud);  /* optional, switch UART rate once the response is out, 0: ok */
+    int (*op_check_baud)(uint32_t baud);    /* optional, 0: op_set_baud can reach the rate */
+    uint32_t cfg_uart_baud;         /* default UART rate, restored if the host is lost after a change */
+    uint32_t cfg_max_packet_len;    /* MaxPacketSize reported and accepted, 0 or above MAX_PACKET_LEN: MAX_PACKET_LEN,
+                                       rounded down to a multiple of KPTL_PACKET_ALIGN */
     
     /* mcu boot private resource */
     uint32_t mem_start_addr;
     uint32_t mem_len;
     uint32_t mem_cur_addr;
+    uint32_t wr_status;             /* first program error of the running WriteMemory, 0: none */
+    uint8_t baud_pending;           /* rate changed, waiting for the host to talk at the new rate */
+    uint32_t baud_start;
+    uint8_t erase_active;           /* FlashEraseRegion running, response sent when done */
+    uint32_t erase_done;            /* bytes erased so far */
+    uint32_t erase_len;             /* length of the last FlashEraseRegion */
+    uint8_t rd_state;
+    uint32_t rd_addr;
+    uint32_t rd_remain;
+    uint32_t rd_chunk;              /* length of the data frame waiting for ACK */
+    uint32_t nak_sent;              /* dropped frames answered, follows dec.nak_cnt */
+#if (MCUBOOT_PIPELINE_WRITE)
+    mcuboot_wr_buf_t wr_buf[MCUBOOT_WR_BUF_CNT];
+    uint8_t wr_head;
+    uint8_t wr_tail;
+    uint8_t wr_cnt;
+#endif
+    
+    /* statistics of last WriteMemory: from command to final response */
+    uint32_t stat_write_start;
+    uint32_t stat_write_ticks;
+    uint32_t stat_write_bps;        /* effective bytes/s */
+    
+    /* ticks from last byte of a command/data frame to its ACK */
+    uint32_t stat_ack_latency;
+    uint32_t stat_ack_latency_max;
 }mcuboot_t;
 
 
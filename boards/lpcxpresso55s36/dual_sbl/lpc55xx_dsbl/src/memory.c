@@ -8,10 +8,14 @@
 #include "memory.h"
 #include "fsl_flash.h"
 #include "fsl_flash_ffr.h"
+#include "sbl_config.h"
 
 #include <string.h>
 #include "fsl_debug_console.h"
 
+/* fsl_flash_ffr.h has signed versions, these keep the type of x */
+#undef ALIGN_DOWN
+#undef ALIGN_UP
 #define ALIGN_DOWN(x, a)    ((x) & -(a))
 #define ALIGN_UP(x, a)      (-(-(x) & -(a)))
 
@@ -32,6 +36,10 @@
 #define CH_OK           (0)
 #define CH_ERR          (1)
 #define SECTOR_SIZE     (32*1024)
+#define PAGE_SIZE       (512)
+
+/* RAM staging buffer of memory_copy, pages programmed per ROM call */
+#define COPY_BUF_SIZE   (8*PAGE_SIZE)
 
 #define LIB_DEBUG
 
@@ -49,9 +57,33 @@
 /* memory instance */
 static flash_config_t flashInstance;
 
+/* memory access statistics */
+static memory_stat_t memStat;
+
+/* non-blocking erase in progress */
+static struct
+{
+    uint32_t addr;
+    uint32_t len;
+    uint32_t done;          /* bytes erased or found blank */
+    uint32_t cmd_len;       /* length of the running erase command, 0: none */
+    bool busy;
+}eraseCtx;
+
 
 int memory_init(void)
 {
+    /* cycle counter for timing statistics */
+#if (SBL_BOOT_PROFILE)
+    /* boot_prof_init started it, the timeline counts from main */
+    if(!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+#endif
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    
     flashInstance.modeConfig.sysFreqInMHz = CLOCK_GetFreq(kCLOCK_CoreSysClk) / (1000*1000);
     if (FLASH_Init(&flashInstance) == kStatus_Success)
     {
@@ -63,55 +95,361 @@ int memory_init(void)
     }
 }
 
+/* erase a page aligned range, pages already blank are skipped, runs of the others are erased together */
 int memory_erase(uint32_t addr, uint32_t len)
 {
-    status_t ret;
+    status_t ret = kStatus_Success;
+    uint32_t offset, run, run_start;
+    bool blank;
+    
+    len = ALIGN_UP(len, PAGE_SIZE);
     
-    ret = FLASH_Erase(&flashInstance, addr, len, kFLASH_ApiEraseKey);
+    /* common case: whole range is blank, one blank check and done */
+    if(FLASH_VerifyErase(&flashInstance, addr, len) == kStatus_Success)
+    {
+        memStat.erase_skip_cnt += len / PAGE_SIZE;
+        return 0;
+    }
+    
+    run = 0;
+    run_start = 0;
+    for(offset = 0; (offset < len) && (ret == kStatus_Success); offset += PAGE_SIZE)
+    {
+        blank = (FLASH_VerifyErase(&flashInstance, addr + offset, PAGE_SIZE) == kStatus_Success);
+        if(blank)
+        {
+            memStat.erase_skip_cnt++;
+        }
+        else
+        {
+            if(run == 0)
+            {
+                run_start = offset;
+            }
+            run += PAGE_SIZE;
+        }
+        
+        /* flush the run at a blank page or the end */
+        if(run && (blank || ((offset + PAGE_SIZE) >= len)))
+        {
+            memStat.erase_cnt++;
+            memStat.erase_page_cnt += run / PAGE_SIZE;
+            ret = FLASH_Erase(&flashInstance, addr + run_start, run, kFLASH_ApiEraseKey);
+            run = 0;
+        }
+    }
     return ret;
 }
 
-int memory_write(uint32_t start_addr, uint8_t *buf, uint32_t len)
+/* true if every page of the range is erased */
+bool memory_is_blank(uint32_t addr, uint32_t len)
+{
+    return (FLASH_VerifyErase(&flashInstance, addr, ALIGN_UP(len, PAGE_SIZE)) == kStatus_Success);
+}
+
+/* range lies in flash, anything else (RAM) is read directly */
+bool memory_is_flash(uint32_t addr, uint32_t len)
+{
+    return (addr >= flashInstance.PFlashBlockBase) && (len <= flashInstance.PFlashTotalSize) &&
+           (addr - flashInstance.PFlashBlockBase <= flashInstance.PFlashTotalSize - len);
+}
+
+/*
+    start a non-blocking erase of a page aligned range, driven by memory_erase_poll().
+    the range is erased MEMORY_ERASE_CHUNK at a time, blank chunks are skipped, so the caller
+    gets control back between chunks and can report progress.
+*/
+int memory_erase_start(uint32_t addr, uint32_t len)
+{
+    if(eraseCtx.busy)
+    {
+        return 1;
+    }
+    
+    eraseCtx.addr = addr;
+    eraseCtx.len = ALIGN_UP(len, PAGE_SIZE);
+    eraseCtx.done = 0;
+    eraseCtx.cmd_len = 0;
+    eraseCtx.busy = true;
+    return 0;
+}
+
+/* MEMORY_BUSY while erasing, then 0 or the failing flash status. done: bytes finished so far */
+int memory_erase_poll(uint32_t *done)
 {
     status_t ret;
-    ALIGN(512) static uint8_t  tmp_buf[512];
+    uint32_t n;
+    
+    if(done)
+    {
+        *done = eraseCtx.done;
+    }
     
-    memcpy(tmp_buf, buf, len);
+    if(!eraseCtx.busy)
+    {
+        return 0;
+    }
+    
+    if(eraseCtx.cmd_len)
+    {
+        ret = FLASH_GetCommandState(&flashInstance);
+        if(ret == kStatus_FLASH_CommandOperationInProgress)
+        {
+            return MEMORY_BUSY;
+        }
+        
+        eraseCtx.done += eraseCtx.cmd_len;
+        eraseCtx.cmd_len = 0;
+        if(ret != kStatus_Success)
+        {
+            eraseCtx.busy = false;
+            return ret;
+        }
+    }
+    
+    while(eraseCtx.done < eraseCtx.len)
+    {
+        n = eraseCtx.len - eraseCtx.done;
+        n = (n > MEMORY_ERASE_CHUNK)?(MEMORY_ERASE_CHUNK):(n);
+        
+        if(FLASH_VerifyErase(&flashInstance, eraseCtx.addr + eraseCtx.done, n) == kStatus_Success)
+        {
+            memStat.erase_skip_cnt += n / PAGE_SIZE;
+            eraseCtx.done += n;
+            continue;
+        }
+        
+        memStat.erase_cnt++;
+        memStat.erase_page_cnt += n / PAGE_SIZE;
+        ret = FLASH_EraseNonBlocking(&flashInstance, eraseCtx.addr + eraseCtx.done, n, kFLASH_ApiEraseKey);
+        if(ret != kStatus_Success)
+        {
+            eraseCtx.busy = false;
+            return ret;
+        }
+        eraseCtx.cmd_len = n;
+        return MEMORY_BUSY;
+    }
+    
+    if(done)
+    {
+        *done = eraseCtx.done;
+    }
+    eraseCtx.busy = false;
+    return 0;
+}
+
+/* program len bytes to erased flash, len may span several pages (large mcuboot packets) */
+int memory_write(uint32_t start_addr, uint8_t *buf, uint32_t len)
+{
+    status_t ret = kStatus_Success;
+    ALIGN(512) static uint8_t  tmp_buf[PAGE_SIZE];
+    uint32_t offset, n;
     
     /* for LPC55xx, safe protect, do not erase last sector */
     if((start_addr + len) > 512*1024)
     {
       return 1;
     }
-    ret = FLASH_Program(&flashInstance, start_addr, tmp_buf, 512);
+    
+    for(offset = 0; (offset < len) && (ret == kStatus_Success); offset += n)
+    {
+        n = len - offset;
+        if((n >= PAGE_SIZE) && !(((uintptr_t)(buf + offset)) & 0x3))
+        {
+            /* whole pages straight from caller's buffer in one ROM call */
+            n = ALIGN_DOWN(n, PAGE_SIZE);
+            memStat.program_cnt++;
+            ret = FLASH_Program(&flashInstance, start_addr + offset, buf + offset, n);
+        }
+        else
+        {
+            /* one page through the staging buffer, tail padded with erased value */
+            n = (n > PAGE_SIZE)?(PAGE_SIZE):(n);
+            memcpy(tmp_buf, buf + offset, n);
+            memset(tmp_buf + n, 0xFF, PAGE_SIZE - n);
+            memStat.program_cnt++;
+            ret = FLASH_Program(&flashInstance, start_addr + offset, tmp_buf, PAGE_SIZE);
+        }
+    }
     return ret;
 }
 
 
 int memory_read(uint32_t addr, uint8_t *buf, uint32_t len)
 {
+    memStat.read_cnt++;
     return FLASH_Read(&flashInstance, addr, buf, len);
 }
 
+/*
+    get a read-only pointer to a memory mapped flash range so it can be accessed in place.
+    return NULL if the range can not be read directly, caller should fall back to memory_read.
+    reading an erased or torn page in place is an ECC bus fault, a torn page is neither hidden
+    nor blank, so every page of the range is probed with the ECC checked FLASH_Read.
+*/
+const uint8_t *memory_map(uint32_t addr, uint32_t len)
+{
+    ALIGN(512) static uint8_t probe_buf[PAGE_SIZE];
+    uint32_t page;
+    
+    if((len == 0) || (addr < flashInstance.PFlashBlockBase) ||
+       ((addr + len) > (flashInstance.PFlashBlockBase + flashInstance.PFlashTotalSize)))
+    {
+        return NULL;
+    }
+    
+    if(FLASH_IsFlashAreaReadable(&flashInstance, addr, len) != kStatus_Success)
+    {
+        return NULL;
+    }
+    
+    for(page = ALIGN_DOWN(addr, flashInstance.PFlashPageSize); page < (addr + len); page += flashInstance.PFlashPageSize)
+    {
+        memStat.read_cnt++;
+        if(FLASH_Read(&flashInstance, page, probe_buf, flashInstance.PFlashPageSize) != kStatus_Success)
+        {
+            return NULL;
+        }
+    }
+    
+    memStat.map_cnt++;
+    return (const uint8_t *)(uintptr_t)addr;
+}
+
+const memory_stat_t *memory_get_stat(void)
+{
+    return &memStat;
+}
+
+/* program len bytes (at most COPY_BUF_SIZE) from flash to erased flash through the RAM staging buffer */
+static int _program_run(uint32_t to, uint32_t from, uint32_t len)
+{
+    ALIGN(512) static uint8_t  copy_buf[COPY_BUF_SIZE];
+    
+    memcpy(copy_buf, (void*)(uintptr_t)from, len);
+    
+    /* pad the last page with erased value */
+    memset(copy_buf + len, 0xFF, ALIGN_UP(len, PAGE_SIZE) - len);
+    
+    memStat.program_cnt++;
+    return FLASH_Program(&flashInstance, to, copy_buf, ALIGN_UP(len, PAGE_SIZE));
+}
+
+/*
+    copy flash to flash: the whole destination is erased by one ROM call,
+    then programmed COPY_BUF_SIZE at a time from a RAM staging buffer.
+*/
 int memory_copy(uint32_t to, uint32_t from, uint32_t len)
 {
-    int i;
+    uint32_t erase_len, offset, n, t;
     int ret;
     
-    for(i=0; i<len / 512; i++)
+    erase_len = ALIGN_UP(len, PAGE_SIZE);
+    
+    /* for LPC55xx, safe protect, do not erase last sector */
+    if((to + erase_len) > 512*1024)
+    {
+        return 1;
+    }
+    
+    t = DWT->CYCCNT;
+    ret = memory_erase(to, erase_len);
+    memStat.copy_erase_cycles = DWT->CYCCNT - t;
+    
+    t = DWT->CYCCNT;
+    for(offset = 0; (offset < len) && (ret == 0); offset += n)
     {
-        ret = 0;
-        ret |= memory_erase(to+512*i, 512);
-        ret |= memory_write(to+512*i, (void*)(from+512*i), 512);
+        n = ((len - offset) > COPY_BUF_SIZE)?(COPY_BUF_SIZE):(len - offset);
+        ret = _program_run(to + offset, from + offset, n);
+    }
+    memStat.copy_program_cycles = DWT->CYCCNT - t;
+    return ret;
+}
+
+/* true if the destination page holds the source data, padded with erased value as _program_run writes it */
+static bool _page_same(uint32_t to, uint32_t from, uint32_t n)
+{
+    ALIGN(512) static uint8_t page_buf[PAGE_SIZE];
+    uint32_t i;
+    
+    /* read through the ROM: an erased or torn page reports an error instead of faulting */
+    if(memory_read(to, page_buf, PAGE_SIZE) != kStatus_Success)
+    {
+        return false;
     }
     
-    if(len % 512)
+    if(memcmp(page_buf, (void*)(uintptr_t)from, n) != 0)
     {
-        ret = 0;
-        ret |= memory_erase(to+512*i, 512);
-        ret |= memory_write(to+512*i, (void*)(from+512*i), len % 512);
+        return false;
     }
     
+    for(i = n; i < PAGE_SIZE; i++)
+    {
+        if(page_buf[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    differential copy: pages whose destination already holds the source data are skipped,
+    runs of differing pages are erased and programmed together.
+*/
+int memory_copy_diff(uint32_t to, uint32_t from, uint32_t len)
+{
+    uint32_t offset, n, run, run_start, t;
+    bool same;
+    int ret;
+    
+    /* for LPC55xx, safe protect, do not erase last sector */
+    if((to + ALIGN_UP(len, PAGE_SIZE)) > 512*1024)
+    {
+        return 1;
+    }
+    
+    memStat.diff_skip_cnt = 0;
+    memStat.diff_copy_cnt = 0;
+    run = 0;
+    run_start = 0;
+    ret = 0;
+    
+    t = DWT->CYCCNT;
+    for(offset = 0; (offset < len) && (ret == 0); offset += PAGE_SIZE)
+    {
+        n = ((len - offset) > PAGE_SIZE)?(PAGE_SIZE):(len - offset);
+        
+        same = _page_same(to + offset, from + offset, n);
+        
+        if(same)
+        {
+            memStat.diff_skip_cnt++;
+        }
+        else
+        {
+            if(run == 0)
+            {
+                run_start = offset;
+            }
+            run += n;
+            memStat.diff_copy_cnt++;
+        }
+        
+        /* flush the run at an identical page, a full staging buffer or the end */
+        if(run && (same || (run >= COPY_BUF_SIZE) || ((offset + n) >= len)))
+        {
+            ret = memory_erase(to + run_start, ALIGN_UP(run, PAGE_SIZE));
+            if(ret == 0)
+            {
+                ret = _program_run(to + run_start, from + run_start, run);
+            }
+            run = 0;
+        }
+    }
+    memStat.copy_program_cycles = DWT->CYCCNT - t;
+    memStat.copy_erase_cycles = 0;
     return ret;
 }
 
@@ -121,7 +459,7 @@ uint32_t FLASH_SetcorTest(uint32_t addr)
     uint8_t *p;
     ALIGN(512) static  uint8_t buf[512];
     
-    LIB_TRACE("program addr:0x%X(%dKB) ...", addr, addr/1024);
+    LIB_TRACE("program addr:0x%X(%uKB) ...", addr, addr/1024);
     ret = memory_erase(addr, SECTOR_SIZE);
     
     for(i=0; i<sizeof(buf); i++)
@@ -149,7 +487,7 @@ uint32_t FLASH_SetcorTest(uint32_t addr)
             if(p[j] != (j%0xFF))
             {
                 ret++;
-                LIB_TRACE("ERR:[%d]:0x%02X ", i, *p); 
+                LIB_TRACE("ERR:[%u]:0x%02X ", i, *p); 
             }
         }
     }
@@ -163,7 +501,8 @@ uint32_t FLASH_SetcorTest(uint32_t addr)
 
 uint32_t FLASH_Test(uint32_t addr, uint32_t len)
 {
-    int i, ret;
+    uint32_t i;
+    int ret;
 
     for(i=0; i<(len/SECTOR_SIZE); i++)
     {
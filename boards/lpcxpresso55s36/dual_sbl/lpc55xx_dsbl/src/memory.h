@@ -14,14 +14,45 @@
 
 #include <stdlib.h>
 #include <stdint.h>
-
+#include <stdbool.h>
+
+/* flash page, unit of program and blank check */
+#define MEMORY_PAGE_SIZE        (512)
+
+/* memory_erase_poll: erase still running */
+#define MEMORY_BUSY             (-1)
+
+/* bytes erased per non-blocking erase command, between two polls */
+#define MEMORY_ERASE_CHUNK      (8*512)
+
+/* memory access statistics */
+typedef struct
+{
+    uint32_t read_cnt;          /* FLASH_Read calls */
+    uint32_t map_cnt;           /* ranges accessed in place */
+    uint32_t erase_cnt;         /* FLASH_Erase calls */
+    uint32_t erase_page_cnt;    /* pages erased */
+    uint32_t erase_skip_cnt;    /* pages found blank, not erased */
+    uint32_t program_cnt;       /* FLASH_Program calls */
+    uint32_t copy_erase_cycles;     /* last memory_copy: erase phase */
+    uint32_t copy_program_cycles;   /* last memory_copy: program phase */
+    uint32_t diff_skip_cnt;     /* last memory_copy_diff: identical pages skipped */
+    uint32_t diff_copy_cnt;     /* last memory_copy_diff: pages rewritten */
+}memory_stat_t;
    
 int memory_init(void);
 int memory_erase(uint32_t addr, uint32_t len);
+int memory_erase_start(uint32_t addr, uint32_t len);
+int memory_erase_poll(uint32_t *done);
 int memory_write(uint32_t addr, uint8_t *buf, uint32_t len);
 int memory_read(uint32_t addr, uint8_t *buf, uint32_t len);
 int memory_copy(uint32_t to, uint32_t from, uint32_t len);
+int memory_copy_diff(uint32_t to, uint32_t from, uint32_t len);
 int memory_flash_read(uint32_t addr, uint8_t *buf, uint32_t len);
+const uint8_t *memory_map(uint32_t addr, uint32_t len);
+bool memory_is_blank(uint32_t addr, uint32_t len);
+bool memory_is_flash(uint32_t addr, uint32_t len);
+const memory_stat_t *memory_get_stat(void);
 
 #ifdef __cplusplus
 }
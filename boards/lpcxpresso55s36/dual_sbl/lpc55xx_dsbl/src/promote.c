@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "promote.h"
+#include "memory.h"
+#include "sbl_config.h"
+
+#if (!SBL_AB_BOOT)
+
+/*
+    copy backup image into golden region. progress is journaled in the parameter area,
+    a promotion cut by power loss resumes at the last completed chunk on next boot.
+    backup region is not touched, so a chunk can always be copied again.
+    the chunk being written when power was lost may hold torn pages, it is rewritten as a whole
+    without reading golden region, later chunks are compared first if SBL_DIFF_PROMOTE.
+*/
+int image_promote(uint32_t baddr, ihdr_t *bhdr, sbl_nvm_t *nvm)
+{
+    uint32_t len, offset, n, resume_at;
+    int ret = 0;
+    
+    (bhdr->img_type == 0x00000001)?(len = BACKUP_REGION_LEN):(len = bhdr->img_len + 4);
+    
+    /* journal of another image: start over */
+    if((nvm->promote_src != baddr) || (nvm->promote_crc != bhdr->crc_value) || (nvm->promote_done >= len))
+    {
+        nvm->promote_src = baddr;
+        nvm->promote_crc = bhdr->crc_value;
+        nvm->promote_done = 0;
+        sbl_nvm_write(nvm);
+        resume_at = len;
+    }
+    else
+    {
+        DIMAGE_TRACE("resume promotion at 0x%08X\r\n", nvm->promote_done);
+        resume_at = nvm->promote_done;
+    }
+    
+    for(offset = nvm->promote_done; (offset < len) && (ret == 0); offset += n)
+    {
+        n = ((len - offset) > PROMOTE_CHUNK)?(PROMOTE_CHUNK):(len - offset);
+#if (SBL_DIFF_PROMOTE)
+        if(offset != resume_at)
+        {
+            ret = memory_copy_diff(GOLDEN_REGION_START + offset, baddr + offset, n);
+        }
+        else
+#endif
+        {
+            ret = memory_copy(GOLDEN_REGION_START + offset, baddr + offset, n);
+        }
+        /* last chunk is covered by closing the journal */
+        if((ret == 0) && ((offset + n) < len))
+        {
+            nvm->promote_done = offset + n;
+            sbl_nvm_write(nvm);
+        }
+    }
+    
+    if(ret == 0)
+    {
+        nvm->promote_src = 0;
+        nvm->promote_crc = 0;
+        nvm->promote_done = 0;
+        sbl_nvm_write(nvm);
+    }
+    return ret;
+}
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __PROMOTE_H__
+#define __PROMOTE_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+#include "dimage.h"
+#include "sbl_api.h"
+
+/* golden region is written in chunks, the journal is updated after each one */
+#define PROMOTE_CHUNK       (4*1024)
+
+int image_promote(uint32_t baddr, ihdr_t *bhdr, sbl_nvm_t *nvm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,11 +8,35 @@
 #include "sbl_api.h"
 #include "memory.h"
 #include "sbl_config.h"
+#include "crc32.h"
 #include "fsl_common.h"
+#include <string.h>
+#include <stddef.h>
 
 
 #define MAX_RETRY_CNT   (3)
 
+/*
+    parameter area is split into two banks used in ping-pong. each write appends a record to the
+    next blank page of the active bank, the valid record with the highest sequence number is the
+    current one. when the active bank is full the other bank is erased and the record goes to its
+    first page, the bank holding the newest record is never erased so a power loss at any point
+    still leaves a valid record.
+*/
+#define NVM_PAGE_SIZE       (512)
+#define NVM_PAGE_CNT        (BL_DATA_SIZE / NVM_PAGE_SIZE)
+#define NVM_BANK_PAGE_CNT   (NVM_PAGE_CNT / NVM_BANK_CNT)
+#define NVM_REC_MAGIC       (0x324D564E)    /* "NVM2" */
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;               /* increased by every write */
+    uint32_t bank_erase_cnt[NVM_BANK_CNT];  /* erase cycles of each bank, carried from record to record */
+    sbl_nvm_t nvm;
+    uint32_t crc;               /* CRC32 of all fields above */
+}sbl_nvm_rec_t;
+
 /* 0x00: no re-invoke called, 0x01: re-invoke called */
 
 #ifdef __ICCARM__
@@ -27,7 +51,7 @@ void reinvoke(void)
     
     uint32_t addr = 0x00000000;
     
-    uint32_t *vectorTable = (uint32_t*)addr;
+    uint32_t *vectorTable = (uint32_t*)(uintptr_t)addr;
     uint32_t sp = vectorTable[0];
     uint32_t s_stackPointer = 0;
 
@@ -47,21 +71,120 @@ void reinvoke(void)
     __NOP();
 }
 
+static uint32_t _nvm_rec_crc(sbl_nvm_rec_t *rec)
+{
+    uint32_t crc;
+    
+    crc32_sw_backend.init(&crc);
+    crc32_sw_backend.generate(&crc, (uint8_t*)rec, offsetof(sbl_nvm_rec_t, crc));
+    crc32_sw_backend.complete(&crc);
+    return crc;
+}
+
+/* one pass over the log: return page of newest valid record and the record, -1 if none */
+static int _nvm_find(sbl_nvm_rec_t *rec)
+{
+    sbl_nvm_rec_t tmp;
+    int i, latest = -1;
+    uint32_t addr;
+    
+    for(i=0; i<NVM_PAGE_CNT; i++)
+    {
+        addr = BL_DATA_START + i*NVM_PAGE_SIZE;
+        
+        /* blank page can not be read */
+        if(memory_is_blank(addr, NVM_PAGE_SIZE))
+        {
+            continue;
+        }
+        
+        /* half written page is dropped by crc */
+        if((memory_read(addr, (uint8_t*)&tmp, sizeof(tmp)) != 0) ||
+           (tmp.magic != NVM_REC_MAGIC) || (tmp.crc != _nvm_rec_crc(&tmp)))
+        {
+            continue;
+        }
+        
+        if((latest < 0) || ((int32_t)(tmp.seq - rec->seq) > 0))
+        {
+            *rec = tmp;
+            latest = i;
+        }
+    }
+    return latest;
+}
+
 int sbl_nvm_write(sbl_nvm_t* ctx)
 {
-    memory_erase(BL_DATA_START, BL_DATA_SIZE);
-    memory_write(BL_DATA_START, (void*)ctx, sizeof(sbl_nvm_t));
+    sbl_nvm_rec_t rec;
+    int latest, page, bank;
+    
+    latest = _nvm_find(&rec);
+    if(latest < 0)
+    {
+        memset(&rec, 0, sizeof(rec));
+        page = NVM_PAGE_CNT;
+    }
+    else
+    {
+        rec.seq++;
+        page = latest + 1;
+    }
+    
+    /* active bank full (or page spoiled by an interrupted write): switch to the other bank */
+    if(((page % NVM_BANK_PAGE_CNT) == 0) || !memory_is_blank(BL_DATA_START + page*NVM_PAGE_SIZE, NVM_PAGE_SIZE))
+    {
+        bank = (latest < 0)?(0):((latest / NVM_BANK_PAGE_CNT + 1) % NVM_BANK_CNT);
+        page = bank*NVM_BANK_PAGE_CNT;
+        if(!memory_is_blank(BL_DATA_START + page*NVM_PAGE_SIZE, NVM_BANK_PAGE_CNT*NVM_PAGE_SIZE))
+        {
+            memory_erase(BL_DATA_START + page*NVM_PAGE_SIZE, NVM_BANK_PAGE_CNT*NVM_PAGE_SIZE);
+            rec.bank_erase_cnt[bank]++;
+        }
+    }
+    
+    rec.magic = NVM_REC_MAGIC;
+    rec.nvm = *ctx;
+    rec.crc = _nvm_rec_crc(&rec);
+    return memory_write(BL_DATA_START + page*NVM_PAGE_SIZE, (uint8_t*)&rec, sizeof(rec));
+}
+
+/* endurance accounting of the parameter area */
+int sbl_nvm_get_stat(sbl_nvm_stat_t *stat)
+{
+    sbl_nvm_rec_t rec;
+    int i, latest;
+    
+    memset(stat, 0, sizeof(sbl_nvm_stat_t));
+    latest = _nvm_find(&rec);
+    if(latest < 0)
+    {
+        return -1;
+    }
+    
+    stat->write_cnt = rec.seq + 1;
+    stat->active_bank = latest / NVM_BANK_PAGE_CNT;
+    for(i=0; i<NVM_BANK_CNT; i++)
+    {
+        stat->bank_erase_cnt[i] = rec.bank_erase_cnt[i];
+    }
     return 0;
 }
 
 int sbl_nvm_init(sbl_nvm_t* ctx)
 {
-    memory_read(BL_SIZE, (void*)ctx, sizeof(sbl_nvm_t));
-    if(ctx->marker != BL_DATA_MARKER)
+    sbl_nvm_rec_t rec;
+    
+    if((_nvm_find(&rec) >= 0) && (rec.nvm.marker == BL_DATA_MARKER))
+    {
+        *ctx = rec.nvm;
+    }
+    else
     {
         //printf("bad param, re-init nvm\r\n");
         
         /* init the data */
+        memset(ctx, 0, sizeof(sbl_nvm_t));
         ctx->marker = BL_DATA_MARKER;
         ctx->update_flag = 0;
         ctx->update_retry_cnt = 0;
@@ -71,10 +194,19 @@ int sbl_nvm_init(sbl_nvm_t* ctx)
 }
 
 
+/* flash is about to be modified, cached image records are no longer trusted */
+int sbl_nvm_new_write_gen(void)
+{
+    sbl_nvm_t sbl_nvm;
+    sbl_nvm_init(&sbl_nvm);
+    sbl_nvm.write_gen++;
+    return sbl_nvm_write(&sbl_nvm);
+}
+
 void set_update_flag(void)
 {
     sbl_nvm_t sbl_nvm;
-    sbl_nvm.marker = BL_DATA_MARKER;
+    sbl_nvm_init(&sbl_nvm);
     sbl_nvm.update_flag = 1;
     sbl_nvm.update_retry_cnt = MAX_RETRY_CNT;
     sbl_nvm_write(&sbl_nvm);
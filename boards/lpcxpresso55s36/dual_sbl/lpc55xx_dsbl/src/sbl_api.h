@@ -9,14 +9,47 @@
 
 #include <stdint.h>
 
+/* parameter area banks, used in ping-pong */
+#define NVM_BANK_CNT        (2)
+
+/* record of an image that passed full crc check */
+typedef struct
+{
+    uint32_t region;            /* start of the region the image was found in, 0: record not valid */
+    uint32_t image_addr;        /* image address */
+    uint32_t crc_value;         /* crc_value of image header */
+    uint32_t version;           /* version of image header */
+    uint32_t img_len;           /* img_len of image header */
+    uint32_t write_gen;         /* write generation the image was verified at */
+}sbl_image_rec_t;
+
+enum
+{
+    kSblImageRec_Golden = 0,
+    kSblImageRec_Backup = 1,
+    kSblImageRec_Count,
+};
 
 typedef struct
 {
     uint32_t update_flag;
     uint32_t marker;
     uint32_t update_retry_cnt;  /* max retry count after app call set_update_flag */
+    uint32_t write_gen;         /* increased each time mcuboot starts to modify flash */
+    sbl_image_rec_t image_rec[kSblImageRec_Count];
+    uint32_t promote_src;       /* promotion journal: backup image being copied into golden, 0: none */
+    uint32_t promote_crc;       /* promotion journal: crc_value of that image */
+    uint32_t promote_done;      /* promotion journal: bytes of golden region already written */
 }sbl_nvm_t;
 
+/* parameter area wear, from the newest record */
+typedef struct
+{
+    uint32_t write_cnt;         /* records written since area was blank */
+    uint32_t active_bank;       /* bank holding the newest record */
+    uint32_t bank_erase_cnt[NVM_BANK_CNT];  /* erase cycles of each bank */
+}sbl_nvm_stat_t;
+
 typedef struct
 {
     void (*reinvoke)(void);
@@ -24,5 +57,10 @@ typedef struct
     void (*test)(void);
 }sbl_api_t;
 
+int sbl_nvm_init(sbl_nvm_t* ctx);
+int sbl_nvm_write(sbl_nvm_t* ctx);
+int sbl_nvm_new_write_gen(void);
+int sbl_nvm_get_stat(sbl_nvm_stat_t *stat);
+
 
 #endif
@@ -12,7 +12,7 @@
 #define BL_SIZE             (60*1024)
 #define BL_DATA_START       (BL_START + BL_SIZE)
 #define BL_DATA_SIZE        (4*1024)
-#define BL_DATA_MARKER      (0x0FFEB6A7)
+#define BL_DATA_MARKER      (0x0FFEB6A8)
 
 /* golden image region */
 #define GOLDEN_REGION_START      (64*1024)
@@ -22,6 +22,26 @@
 #define BACKUP_REGION_START     (128*1024)
 #define BACKUP_REGION_LEN       (64*1024)
 
+/* image crc check: 1: use CRC engine, 0: use software tables */
+#define SBL_USE_HW_CRC          (1)
+
+/* backup promotion: 1: only rewrite golden pages that differ from backup, 0: rewrite whole image */
+#define SBL_DIFF_PROMOTE        (1)
+
+/* mcuboot uart receive: 1: DMA ring, decoded in batches, 0: one interrupt per byte */
+#define SBL_USE_UART_DMA        (1)
+
+/*
+    boot mode: 1: A/B, golden and backup regions are two slots, each image is linked for the slot it is
+    downloaded to and runs in place, the newest valid slot is booted and the other one is the fallback.
+    mcuboot downloads into the slot not holding the newest image.
+    0: copy, images are linked for golden region and a newer backup is copied into it before boot.
+*/
+#define SBL_AB_BOOT             (0)
+
+/* boot profiling: 1: DWT timestamps of boot phases, kept in SRAMX and printed before jump, see boot_prof.h */
+#define SBL_BOOT_PROFILE        (0)
+
 
 
 #endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "uart_dma.h"
+#include "fsl_usart.h"
+#include "fsl_dma.h"
+
+#include <string.h>
+
+/*
+ * USART0 RX is moved into a RAM ring by DMA0 with two linked descriptors
+ * (ping-pong), each half raises INTA/INTB when filled. The USART has no
+ * rx idle interrupt, so a partly filled half is picked up by uart_dma_rx_poll()
+ * from the main loop. The current write position is derived from the channel
+ * XFERCFG register: SETINTB tells which half is active, XFERCOUNT how much is left.
+ * A DMA error stops the channel, the ring is restarted from its first half.
+ */
+
+static dma_handle_t rx_dma_handle;
+DMA_ALLOCATE_LINK_DESCRIPTORS(rx_desc, 2);
+static uint8_t rx_buf[UART_DMA_RX_BUF_SIZE];
+static uint32_t rx_rd;
+static uart_dma_rx_cb_t rx_cb;
+static uart_dma_stat_t rx_stat;
+
+/* byte offset in rx_buf the DMA will write next */
+static uint32_t _write_index(void)
+{
+    uint32_t cfg, remain, half;
+
+    /* one register read, half and count are consistent */
+    cfg = DMA0->CHANNEL[UART_DMA_RX_CHANNEL].XFERCFG;
+    half = (cfg & DMA_CHANNEL_XFERCFG_SETINTB_MASK)?(UART_DMA_RX_HALF_SIZE):(0);
+    remain = ((cfg & DMA_CHANNEL_XFERCFG_XFERCOUNT_MASK) >> DMA_CHANNEL_XFERCFG_XFERCOUNT_SHIFT) + 1;
+
+    /* count wrapped: half is complete but next descriptor not loaded yet */
+    if(remain > UART_DMA_RX_HALF_SIZE)
+    {
+        remain = 0;
+    }
+
+    return (half + UART_DMA_RX_HALF_SIZE - remain) % UART_DMA_RX_BUF_SIZE;
+}
+
+/* hand everything between read and write position to the consumer */
+static uint32_t _drain(void)
+{
+    uint32_t wr, len = 0;
+
+    wr = _write_index();
+
+    if(wr < rx_rd)
+    {
+        rx_cb(&rx_buf[rx_rd], UART_DMA_RX_BUF_SIZE - rx_rd);
+        len += UART_DMA_RX_BUF_SIZE - rx_rd;
+        rx_rd = 0;
+    }
+
+    if(wr > rx_rd)
+    {
+        rx_cb(&rx_buf[rx_rd], wr - rx_rd);
+        len += wr - rx_rd;
+        rx_rd = wr;
+    }
+
+    rx_stat.byte_cnt += len;
+    return len;
+}
+
+/* (re)load the first descriptor and let the USART requests run the channel */
+static void _rx_start(void)
+{
+    rx_rd = 0;
+    DMA_SubmitChannelDescriptor(&rx_dma_handle, &rx_desc[0]);
+    DMA_StartTransfer(&rx_dma_handle);
+}
+
+static void _dma_cb(dma_handle_t *handle, void *userData, bool transferDone, uint32_t intmode)
+{
+    if(!transferDone)
+    {
+        /* channel stopped, the write position is lost with it: drop what is not handed over yet,
+           the host repeats the frame on timeout or NAK */
+        rx_stat.err_cnt++;
+        DMA_AbortTransfer(&rx_dma_handle);
+        _rx_start();
+        return;
+    }
+
+    rx_stat.half_evt_cnt++;
+    _drain();
+}
+
+int uart_dma_rx_init(uart_dma_rx_cb_t cb)
+{
+    uint32_t xfer_a, xfer_b;
+
+    rx_cb = cb;
+    rx_rd = 0;
+    memset(&rx_stat, 0, sizeof(rx_stat));
+
+    DMA_Init(DMA0);
+    DMA_SetChannelConfig(DMA0, UART_DMA_RX_CHANNEL, NULL, true);
+    DMA_CreateHandle(&rx_dma_handle, DMA0, UART_DMA_RX_CHANNEL);
+    DMA_SetCallback(&rx_dma_handle, _dma_cb, NULL);
+
+    /* first half signals INTA, second half INTB, each reloads the other */
+    xfer_a = DMA_CHANNEL_XFER(true, false, true, false, 1, kDMA_AddressInterleave0xWidth, kDMA_AddressInterleave1xWidth, UART_DMA_RX_HALF_SIZE);
+    xfer_b = DMA_CHANNEL_XFER(true, false, false, true, 1, kDMA_AddressInterleave0xWidth, kDMA_AddressInterleave1xWidth, UART_DMA_RX_HALF_SIZE);
+    DMA_SetupDescriptor(&rx_desc[0], xfer_a, (void *)&USART0->FIFORD, &rx_buf[0], &rx_desc[1]);
+    DMA_SetupDescriptor(&rx_desc[1], xfer_b, (void *)&USART0->FIFORD, &rx_buf[UART_DMA_RX_HALF_SIZE], &rx_desc[0]);
+
+    USART_EnableRxDMA(USART0, true);
+    _rx_start();
+
+    return 0;
+}
+
+/* called from main loop: pick up bytes of a half that is not full yet */
+void uart_dma_rx_poll(void)
+{
+    uint32_t flags;
+
+    /* receive errors do not stop the DMA, count and clear them, a broken frame fails its CRC */
+    flags = USART_GetStatusFlags(USART0) & (kUSART_RxError | kUSART_FramingErrorFlag | kUSART_ParityErrorFlag | kUSART_NoiseErrorFlag);
+    if(flags)
+    {
+        rx_stat.uart_err_cnt++;
+        USART_ClearStatusFlags(USART0, flags);
+    }
+
+    /* DMA ISR is the other producer of the decoder, keep them apart */
+    DisableIRQ(DMA0_IRQn);
+    if(_drain())
+    {
+        rx_stat.poll_evt_cnt++;
+    }
+    EnableIRQ(DMA0_IRQn);
+}
+
+void uart_dma_rx_deinit(void)
+{
+    DMA_DisableChannel(DMA0, UART_DMA_RX_CHANNEL);
+    DisableIRQ(DMA0_IRQn);
+    USART_EnableRxDMA(USART0, false);
+}
+
+const uart_dma_stat_t *uart_dma_get_stat(void)
+{
+    return &rx_stat;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __UART_DMA_H__
+#define __UART_DMA_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* DMA receive ring, split into two halves, each half raises one DMA interrupt */
+#define UART_DMA_RX_BUF_SIZE    (512)
+#define UART_DMA_RX_HALF_SIZE   (UART_DMA_RX_BUF_SIZE / 2)
+
+/* DMA0 channel hard wired to FLEXCOMM0 RX request */
+#define UART_DMA_RX_CHANNEL     (4)
+
+/* receive statistics */
+typedef struct
+{
+    uint32_t half_evt_cnt;      /* half/full DMA interrupts */
+    uint32_t poll_evt_cnt;      /* batches picked up by polling (line idle) */
+    uint32_t byte_cnt;          /* bytes handed to the consumer */
+    uint32_t err_cnt;           /* DMA errors, the ring is restarted */
+    uint32_t uart_err_cnt;      /* USART receive errors: FIFO overflow, framing, parity, noise */
+}uart_dma_stat_t;
+
+/* consumer of a received batch, called from DMA ISR or uart_dma_rx_poll() */
+typedef void (*uart_dma_rx_cb_t)(uint8_t *buf, uint32_t len);
+
+int uart_dma_rx_init(uart_dma_rx_cb_t cb);
+void uart_dma_rx_poll(void);
+void uart_dma_rx_deinit(void);
+const uart_dma_stat_t *uart_dma_get_stat(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
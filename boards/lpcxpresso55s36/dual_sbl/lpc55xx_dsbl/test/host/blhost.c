@@ -0,0 +1,130 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    host side of the framing protocol, written from the protocol description and not from
+    kptl.c: builds the frames blhost sends and splits the device's output into frames.
+*/
+
+#include <string.h>
+#include "host.h"
+
+uint16_t blhost_crc16(uint16_t crc, const uint8_t *p, uint32_t len)
+{
+    int i;
+
+    while(len--)
+    {
+        crc ^= (uint16_t)(*p++) << 8;
+        for(i=0; i<8; i++)
+        {
+            crc = (crc & 0x8000)?((crc << 1) ^ 0x1021):(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t frame(uint8_t *buf, uint8_t type, const uint8_t *payload, uint32_t len)
+{
+    uint16_t crc;
+
+    buf[0] = 0x5A;
+    buf[1] = type;
+    buf[2] = len & 0xFF;
+    buf[3] = len >> 8;
+    memcpy(&buf[6], payload, len);
+    crc = blhost_crc16(0, buf, 4);
+    crc = blhost_crc16(crc, payload, len);
+    buf[4] = crc & 0xFF;
+    buf[5] = crc >> 8;
+    return len + 6;
+}
+
+uint32_t blhost_cmd(uint8_t *buf, uint8_t tag, uint32_t param_cnt, const uint32_t *param)
+{
+    uint8_t payload[4 + 7*4];
+    uint32_t i;
+
+    payload[0] = tag;
+    payload[1] = 0;
+    payload[2] = 0;
+    payload[3] = param_cnt;
+    for(i=0; i<param_cnt*4; i++)
+    {
+        payload[4 + i] = param[i / 4] >> (8 * (i & 3));
+    }
+    return frame(buf, 0xA4, payload, 4 + param_cnt*4);
+}
+
+uint32_t blhost_data(uint8_t *buf, const uint8_t *data, uint32_t len)
+{
+    return frame(buf, 0xA5, data, len);
+}
+
+uint32_t blhost_short(uint8_t *buf, uint8_t type)
+{
+    buf[0] = 0x5A;
+    buf[1] = type;
+    return 2;
+}
+
+/* next frame of the device's output at *pos, 0 at the end or on a malformed frame */
+uint32_t blhost_next(const uint8_t *buf, uint32_t len, uint32_t *pos, blhost_frame_t *f)
+{
+    const uint8_t *p = buf + *pos;
+    uint32_t left = len - *pos, n, i;
+
+    memset(f, 0, sizeof(*f));
+    if((left < 2) || (p[0] != 0x5A))
+    {
+        return 0;
+    }
+    f->type = p[1];
+    switch(f->type)
+    {
+        case 0xA1:
+        case 0xA2:
+        case 0xA3:
+        case 0xA6:
+            n = 2;
+            break;
+        case 0xA7:
+            n = 10;
+            break;
+        case 0xA4:
+        case 0xA5:
+            if(left < 6)
+            {
+                return 0;
+            }
+            f->len = p[2] | (p[3] << 8);
+            n = 6 + f->len;
+            if((n > left) || (blhost_crc16(blhost_crc16(0, p, 4), p + 6, f->len) != (p[4] | (p[5] << 8))))
+            {
+                return 0;
+            }
+            f->payload = p + 6;
+            if((f->type == 0xA4) && (f->len >= 4))
+            {
+                f->tag = p[6];
+                f->param_cnt = p[9];
+                for(i=0; (i < f->param_cnt) && (i < 7) && (8 + 4*i <= f->len); i++)
+                {
+                    memcpy(&f->param[i], p + 10 + 4*i, 4);
+                }
+            }
+            break;
+        default:
+            return 0;
+    }
+    if(n > left)
+    {
+        return 0;
+    }
+    *pos += n;
+    return n;
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    host model of the LPC55S36 flash behind the fsl_flash ROM API.
+
+    every 512 byte page is erased, programmed or torn (erase or program cut by a power loss).
+    like the real part:
+    - a page is programmed once, programming a page that is not erased fails
+    - FLASH_Read of an erased or torn page returns kStatus_FLASH_EccError
+    - FLASH_VerifyErase succeeds only if every page of the range is erased
+    - FLASH_IsFlashAreaReadable checks the range only, nothing is hidden
+    - reading an erased or torn page through the memory map is a bus fault: flash from
+      FLASH_MODEL_MAP_BASE up is mapped at its real address, host pages holding no programmed
+      flash page are inaccessible and the SIGSEGV handler reports the read. erased or torn pages
+      sharing a host page with programmed ones read as garbage.
+    flash below FLASH_MODEL_MAP_BASE (bootloader, parameter area) is reachable through the
+    API only.
+
+    power cut: flash_model_cut_after(n) lets n page operations complete, the next one leaves its
+    page torn and longjmps to flash_model_cut_jmp.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "fsl_flash.h"
+#include "host.h"
+
+#define PAGE_SIZE       (FLASH_MODEL_PAGE_SIZE)
+#define PAGE_CNT        (FLASH_MODEL_SIZE / PAGE_SIZE)
+#define POLL_BUSY_CNT   (3)
+
+flash_model_stat_t flash_model_stat;
+jmp_buf flash_model_cut_jmp;
+
+static uint8_t low_mem[FLASH_MODEL_MAP_BASE];
+static uint8_t page_state[PAGE_CNT];
+static uint32_t host_page;
+static int32_t cut_left = -1;
+static uint32_t rnd = 1;
+
+static struct
+{
+    uint32_t start;
+    uint32_t len;
+    int polls;
+}pending;
+
+static uint8_t *mem(uint32_t addr)
+{
+    return (addr < FLASH_MODEL_MAP_BASE)?(&low_mem[addr]):((uint8_t *)(uintptr_t)addr);
+}
+
+/* host page is accessible only while it holds a programmed flash page */
+static void protect(uint32_t addr)
+{
+    uint32_t base, a;
+    int prot = PROT_NONE;
+
+    if(addr < FLASH_MODEL_MAP_BASE)
+    {
+        return;
+    }
+    base = addr & ~(host_page - 1);
+    for(a=base; a<base + host_page; a+=PAGE_SIZE)
+    {
+        if(page_state[a / PAGE_SIZE] == kFlashModel_Programmed)
+        {
+            prot = PROT_READ;
+        }
+    }
+    mprotect((void *)(uintptr_t)base, host_page, prot);
+}
+
+static void page_fill(uint32_t addr, const uint8_t *src, uint32_t state)
+{
+    uint32_t base = addr & ~(host_page - 1);
+    int i;
+
+    if(addr >= FLASH_MODEL_MAP_BASE)
+    {
+        mprotect((void *)(uintptr_t)base, host_page, PROT_READ | PROT_WRITE);
+    }
+    for(i=0; i<PAGE_SIZE; i++)
+    {
+        rnd = rnd * 1103515245 + 12345;
+        mem(addr)[i] = (src)?(src[i]):(rnd >> 16);
+    }
+    page_state[addr / PAGE_SIZE] = state;
+    protect(addr);
+}
+
+/* one page operation, the cut point is checked before it completes */
+static void page_op(uint32_t addr, const uint8_t *src)
+{
+    if(cut_left == 0)
+    {
+        cut_left = -1;
+        page_fill(addr, NULL, kFlashModel_Torn);
+        flash_model_stat.cut_addr = addr;
+        longjmp(flash_model_cut_jmp, 1);
+    }
+    if(cut_left > 0)
+    {
+        cut_left--;
+    }
+    flash_model_stat.page_ops++;
+    page_fill(addr, src, (src)?(kFlashModel_Programmed):(kFlashModel_Erased));
+}
+
+static bool in_range(uint32_t start, uint32_t len)
+{
+    return (start < FLASH_MODEL_SIZE) && (len <= FLASH_MODEL_SIZE - start);
+}
+
+static void segv(int sig, siginfo_t *si, void *ctx)
+{
+    uintptr_t a = (uintptr_t)si->si_addr;
+    char msg[96];
+    int n;
+
+    (void)sig;
+    (void)ctx;
+    n = snprintf(msg, sizeof(msg), "flash model: bus fault reading 0x%lx (%s page)\n", (unsigned long)a,
+                 (a < FLASH_MODEL_SIZE)?((page_state[a / PAGE_SIZE] == kFlashModel_Torn)?("torn"):("erased")):("unmapped"));
+    write(2, msg, n);
+    _exit(3);
+}
+
+__attribute__((constructor)) static void flash_model_map(void)
+{
+    struct sigaction sa;
+    void *p;
+
+    host_page = sysconf(_SC_PAGESIZE);
+    p = mmap((void *)FLASH_MODEL_MAP_BASE, FLASH_MODEL_SIZE - FLASH_MODEL_MAP_BASE, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p != (void *)FLASH_MODEL_MAP_BASE)
+    {
+        fprintf(stderr, "flash model: can not map flash at 0x%x\n", (uint32_t)FLASH_MODEL_MAP_BASE);
+        exit(2);
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = segv;
+    sa.sa_flags = SA_SIGINFO;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    flash_model_reset();
+}
+
+void flash_model_reset(void)
+{
+    uint32_t addr;
+
+    for(addr=0; addr<FLASH_MODEL_SIZE; addr+=PAGE_SIZE)
+    {
+        page_fill(addr, NULL, kFlashModel_Erased);
+    }
+    memset(&flash_model_stat, 0, sizeof(flash_model_stat));
+    memset(&pending, 0, sizeof(pending));
+    cut_left = -1;
+}
+
+void flash_model_cut_after(int32_t ops)
+{
+    cut_left = ops;
+}
+
+/* program pages behind the API's back, len is padded to whole pages with 0xFF */
+void flash_model_load(uint32_t addr, const void *data, uint32_t len)
+{
+    uint8_t page[PAGE_SIZE];
+    uint32_t off, n;
+
+    for(off=0; off<len; off+=PAGE_SIZE)
+    {
+        n = (len - off > PAGE_SIZE)?(PAGE_SIZE):(len - off);
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, (const uint8_t *)data + off, n);
+        page_fill(addr + off, page, kFlashModel_Programmed);
+    }
+}
+
+uint32_t flash_model_page_state(uint32_t addr)
+{
+    return page_state[addr / PAGE_SIZE];
+}
+
+/* content of programmed pages, erased and torn ones read as 0xFF */
+void flash_model_peek(uint32_t addr, void *buf, uint32_t len)
+{
+    uint32_t i;
+
+    for(i=0; i<len; i++)
+    {
+        ((uint8_t *)buf)[i] = (page_state[(addr + i) / PAGE_SIZE] == kFlashModel_Programmed)?
+                              (*mem(addr + i)):(0xFF);
+    }
+}
+
+status_t FLASH_Init(flash_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->PFlashBlockBase = 0;
+    config->PFlashTotalSize = FLASH_MODEL_SIZE;
+    config->PFlashPageSize = PAGE_SIZE;
+    config->PFlashSectorSize = 32*1024;
+    return kStatus_Success;
+}
+
+status_t FLASH_Erase(flash_config_t *config, uint32_t start, uint32_t lengthInBytes, uint32_t key)
+{
+    uint32_t addr;
+
+    (void)config;
+    flash_model_stat.erase_cnt++;
+    if((key != kFLASH_ApiEraseKey) || (start % PAGE_SIZE) || (lengthInBytes % PAGE_SIZE) ||
+       !in_range(start, lengthInBytes))
+    {
+        return kStatus_FLASH_InvalidArgument;
+    }
+    for(addr=start; addr<start + lengthInBytes; addr+=PAGE_SIZE)
+    {
+        page_op(addr, NULL);
+    }
+    return kStatus_Success;
+}
+
+status_t FLASH_EraseNonBlocking(flash_config_t *config, uint32_t start, uint32_t lengthInBytes, uint32_t key)
+{
+    (void)config;
+    if((key != kFLASH_ApiEraseKey) || (start % PAGE_SIZE) || (lengthInBytes % PAGE_SIZE) ||
+       !in_range(start, lengthInBytes) || pending.len)
+    {
+        return kStatus_FLASH_InvalidArgument;
+    }
+    pending.start = start;
+    pending.len = lengthInBytes;
+    pending.polls = POLL_BUSY_CNT;
+    return kStatus_Success;
+}
+
+status_t FLASH_GetCommandState(flash_config_t *config)
+{
+    uint32_t len = pending.len;
+
+    if(len && pending.polls--)
+    {
+        return kStatus_FLASH_CommandOperationInProgress;
+    }
+    pending.len = 0;
+    return (len)?(FLASH_Erase(config, pending.start, len, kFLASH_ApiEraseKey)):(kStatus_Success);
+}
+
+/* whole pages are programmed, a partial last page gets its rest programmed as 0xFF */
+status_t FLASH_Program(flash_config_t *config, uint32_t start, uint8_t *src, uint32_t lengthInBytes)
+{
+    uint8_t page[PAGE_SIZE];
+    uint32_t addr, off, n;
+
+    (void)config;
+    flash_model_stat.program_cnt++;
+    if((start % 16) || (lengthInBytes % 16) || !in_range(start, lengthInBytes))
+    {
+        return kStatus_FLASH_AlignmentError;
+    }
+    for(addr=start & ~(PAGE_SIZE - 1); addr<start + lengthInBytes; addr+=PAGE_SIZE)
+    {
+        if(page_state[addr / PAGE_SIZE] != kFlashModel_Erased)
+        {
+            flash_model_stat.program_fail_cnt++;
+            return kStatus_FLASH_CommandFailure;
+        }
+    }
+    for(addr=start & ~(PAGE_SIZE - 1); addr<start + lengthInBytes; addr+=PAGE_SIZE)
+    {
+        memset(page, 0xFF, sizeof(page));
+        off = (addr < start)?(start - addr):(0);
+        n = PAGE_SIZE - off;
+        n = (addr + off + n > start + lengthInBytes)?(start + lengthInBytes - addr - off):(n);
+        memcpy(page + off, src + (addr + off - start), n);
+        page_op(addr, page);
+    }
+    return kStatus_Success;
+}
+
+status_t FLASH_Read(flash_config_t *config, uint32_t start, uint8_t *dest, uint32_t lengthInBytes)
+{
+    uint32_t i;
+
+    (void)config;
+    flash_model_stat.read_cnt++;
+    if(!in_range(start, lengthInBytes))
+    {
+        return kStatus_FLASH_AddressError;
+    }
+    for(i=0; i<lengthInBytes; i++)
+    {
+        if(page_state[(start + i) / PAGE_SIZE] != kFlashModel_Programmed)
+        {
+            flash_model_stat.ecc_err_cnt++;
+            return kStatus_FLASH_EccError;
+        }
+        dest[i] = *mem(start + i);
+    }
+    return kStatus_Success;
+}
+
+status_t FLASH_VerifyErase(flash_config_t *config, uint32_t start, uint32_t lengthInBytes)
+{
+    uint32_t addr;
+
+    (void)config;
+    flash_model_stat.verify_cnt++;
+    if((start % PAGE_SIZE) || (lengthInBytes % PAGE_SIZE) || !in_range(start, lengthInBytes))
+    {
+        return kStatus_FLASH_InvalidArgument;
+    }
+    for(addr=start; addr<start + lengthInBytes; addr+=PAGE_SIZE)
+    {
+        if(page_state[addr / PAGE_SIZE] != kFlashModel_Erased)
+        {
+            return kStatus_FLASH_CommandFailure;
+        }
+    }
+    return kStatus_Success;
+}
+
+/* flash hiding check only, a torn or erased page passes it like on the real part */
+status_t FLASH_IsFlashAreaReadable(flash_config_t *config, uint32_t startAddress, uint32_t lengthInBytes)
+{
+    (void)config;
+    return (in_range(startAddress, lengthInBytes))?(kStatus_Success):(kStatus_FLASH_AddressError);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __HOST_H__
+#define __HOST_H__
+
+#include <stdint.h>
+#include <setjmp.h>
+
+/* crc_model.c: CRC engine bus writes since the last CRC_Init */
+extern uint32_t crc_model_wr8;
+extern uint32_t crc_model_wr32;
+
+/* flash_model.c */
+#define FLASH_MODEL_SIZE        (256*1024)
+#define FLASH_MODEL_PAGE_SIZE   (512)
+#define FLASH_MODEL_MAP_BASE    (0x10000)       /* flash below is reachable through the API only */
+
+enum
+{
+    kFlashModel_Erased = 0,
+    kFlashModel_Programmed,
+    kFlashModel_Torn,
+};
+
+typedef struct
+{
+    uint32_t read_cnt;          /* FLASH_Read calls */
+    uint32_t ecc_err_cnt;       /* FLASH_Read calls failed on an erased or torn page */
+    uint32_t program_cnt;       /* FLASH_Program calls */
+    uint32_t program_fail_cnt;  /* FLASH_Program on a page not erased */
+    uint32_t erase_cnt;         /* erase commands */
+    uint32_t verify_cnt;        /* FLASH_VerifyErase calls */
+    uint32_t page_ops;          /* pages erased or programmed */
+    uint32_t cut_addr;          /* page torn by the last power cut */
+}flash_model_stat_t;
+
+extern flash_model_stat_t flash_model_stat;
+extern jmp_buf flash_model_cut_jmp;
+
+void flash_model_reset(void);
+void flash_model_cut_after(int32_t ops);
+void flash_model_load(uint32_t addr, const void *data, uint32_t len);
+void flash_model_peek(uint32_t addr, void *buf, uint32_t len);
+uint32_t flash_model_page_state(uint32_t addr);
+
+/* blhost.c: host side of the framing protocol */
+typedef struct
+{
+    uint8_t type;               /* frame type, 0xA1 ACK ... 0xA7 ping response */
+    uint32_t len;               /* payload length of command and data frames */
+    const uint8_t *payload;
+    uint8_t tag;                /* command frames: tag, parameters */
+    uint8_t param_cnt;
+    uint32_t param[7];
+}blhost_frame_t;
+
+uint16_t blhost_crc16(uint16_t crc, const uint8_t *p, uint32_t len);
+uint32_t blhost_cmd(uint8_t *buf, uint8_t tag, uint32_t param_cnt, const uint32_t *param);
+uint32_t blhost_data(uint8_t *buf, const uint8_t *data, uint32_t len);
+uint32_t blhost_short(uint8_t *buf, uint8_t type);
+uint32_t blhost_next(const uint8_t *buf, uint32_t len, uint32_t *pos, blhost_frame_t *f);
+
+/* monotonic time in seconds */
+double host_now(void);
+
+#endif
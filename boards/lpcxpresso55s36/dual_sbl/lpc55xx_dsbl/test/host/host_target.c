@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/* what the target provides outside the sources under test */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "fsl_common.h"
+#include "host.h"
+
+#define CORE_MHZ        (150)
+
+uint32_t SystemCoreClock = CORE_MHZ*1000*1000;
+
+/* system control space, so DWT->CYCCNT and CoreDebug accesses land in memory */
+__attribute__((constructor)) static void host_scs_map(void)
+{
+    if(mmap((void *)(SCS_BASE & ~0xFFFFFUL), 0x100000, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) == MAP_FAILED)
+    {
+        fprintf(stderr, "host: can not map the system control space\n");
+        exit(2);
+    }
+}
+
+uint32_t CLOCK_GetFreq(clock_name_t clockName)
+{
+    (void)clockName;
+    return SystemCoreClock;
+}
+
+double host_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
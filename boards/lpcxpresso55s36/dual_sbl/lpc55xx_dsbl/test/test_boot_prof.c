@@ -0,0 +1,134 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    host decoder of the boot timeline on dumps written here: a ring that wrapped, with the core
+    clock raised after the first phases, must print the last BOOT_PROF_RING_SIZE marks oldest
+    first, the microseconds converted at the clock each phase started with. a dump without magic
+    and a short dump are refused.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boot_prof.h"
+
+#define MARK_CNT        (BOOT_PROF_RING_SIZE + 8)
+
+static const char * const name[kBootProf_Count] =
+{
+    "main", "clock init", "memory_init", "sbl_nvm_init", "crc check",
+    "golden scan", "backup scan", "promote", "jump",
+};
+
+static char decoder[256], dump[256];
+
+static void dump_write(const boot_prof_t *prof, uint32_t len)
+{
+    FILE *f = fopen(dump, "wb");
+
+    fwrite(prof, 1, len, f);
+    fclose(f);
+}
+
+/* run the decoder on the dump, its output in out, exit status returned */
+static int decode(char *out, uint32_t size)
+{
+    char cmd[600];
+    FILE *p;
+    uint32_t n;
+
+    snprintf(cmd, sizeof(cmd), "%s %s", decoder, dump);
+    p = popen(cmd, "r");
+    n = fread(out, 1, size - 1, p);
+    out[n] = 0;
+    return pclose(p);
+}
+
+int main(int argc, char *argv[])
+{
+    static char out[8192], expect[8192];
+    boot_prof_t prof;
+    boot_prof_entry_t *e;
+    uint32_t i, cycles, us, prev_cycles, prev_mhz, n;
+    int err = 0;
+
+    (void)argc;
+
+    /* the decoder is built next to this test */
+    n = (strrchr(argv[0], '/'))?((uint32_t)(strrchr(argv[0], '/') - argv[0] + 1)):(0);
+    snprintf(decoder, sizeof(decoder), "%.*sboot_prof_decode", (int)n, argv[0]);
+    snprintf(dump, sizeof(dump), "%.*sboot_prof.bin", (int)n, argv[0]);
+
+    /* marks at 12 MHz up to clock init, 150 MHz after it */
+    memset(&prof, 0xA5, sizeof(prof));
+    prof.magic = BOOT_PROF_MAGIC;
+    prof.cnt = MARK_CNT;
+    cycles = 0xFFFF0000;
+    for(i=0; i<MARK_CNT; i++)
+    {
+        e = &prof.ring[i % BOOT_PROF_RING_SIZE];
+        e->id = (i < 2)?(i):(2 + (i % (kBootProf_Count - 2)));
+        e->mhz = (i < 2)?(12):(150);
+        e->cycles = cycles;
+        cycles += 1000 + i * 777;
+    }
+
+    /* what boot_prof_dump prints for the last ring entries, counter wraps in between */
+    n = snprintf(expect, sizeof(expect), "boot timeline, %d marks:\r\n  phase           cycles      delta       us\r\n", MARK_CNT);
+    e = &prof.ring[(MARK_CNT - BOOT_PROF_RING_SIZE) % BOOT_PROF_RING_SIZE];
+    prev_cycles = e->cycles;
+    prev_mhz = e->mhz;
+    us = 0;
+    for(i=MARK_CNT - BOOT_PROF_RING_SIZE; i<MARK_CNT; i++)
+    {
+        e = &prof.ring[i % BOOT_PROF_RING_SIZE];
+        us += (e->cycles - prev_cycles) / prev_mhz;
+        n += snprintf(expect + n, sizeof(expect) - n, "  %-14s %10u %10u %8u\r\n", name[e->id],
+                      e->cycles, e->cycles - prev_cycles, us);
+        prev_cycles = e->cycles;
+        prev_mhz = e->mhz;
+    }
+
+    dump_write(&prof, sizeof(prof));
+    if(decode(out, sizeof(out)) || strcmp(out, expect))
+    {
+        printf("wrapped ring: decoded\n%s\nexpected\n%s\n", out, expect);
+        err++;
+    }
+
+    /* ring not wrapped, first mark only */
+    prof.cnt = 1;
+    prof.ring[0].id = kBootProf_Main;
+    prof.ring[0].cycles = 0;
+    dump_write(&prof, sizeof(prof));
+    if(decode(out, sizeof(out)) || !strstr(out, "boot timeline, 1 marks:") || !strstr(out, "  main ") ||
+       strstr(out, "clock init"))
+    {
+        printf("one mark: decoded\n%s\n", out);
+        err++;
+    }
+
+    prof.magic = 0xFFFFFFFF;
+    dump_write(&prof, sizeof(prof));
+    if(!decode(out, sizeof(out)))
+    {
+        printf("dump without magic decoded\n");
+        err++;
+    }
+
+    prof.magic = BOOT_PROF_MAGIC;
+    dump_write(&prof, sizeof(prof) - 8);
+    if(!decode(out, sizeof(out)))
+    {
+        printf("short dump decoded\n");
+        err++;
+    }
+
+    printf("boot timeline decoder: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
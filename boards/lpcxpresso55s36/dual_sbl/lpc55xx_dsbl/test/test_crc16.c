@@ -0,0 +1,73 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    kptl crc16_update against an independent bitwise CRC-16/XMODEM on random frames and
+    split updates, then time per 512 byte data frame. built once per KPTL_CRC16_IMPL,
+    the CRC engine build (2) runs on the engine model.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "kptl.h"
+#include "host.h"
+
+#define FRAME_LEN       (6 + 512)
+#define ROUNDS          (20000)
+
+static uint8_t frame[FRAME_LEN];
+
+int main(void)
+{
+    uint16_t crc, ref;
+    uint32_t i, len, pos, n, sink = 0;
+    double t;
+    int err = 0;
+
+    srand(4);
+    for(i=0; i<2000; i++)
+    {
+        len = (i < FRAME_LEN)?(i):((uint32_t)rand() % FRAME_LEN);
+        for(pos=0; pos<len; pos++)
+        {
+            frame[pos] = rand();
+        }
+        ref = blhost_crc16(0, frame, len);
+
+        crc = 0;
+        for(pos=0; pos<len; pos+=n)
+        {
+            n = (i & 1)?((uint32_t)rand() % 37):(len);
+            n = (n > len - pos)?(len - pos):(n);
+            crc16_update(&crc, frame + pos, n);
+        }
+        if(crc != ref)
+        {
+            printf("mismatch len %u: %04x, expected %04x\n", len, crc, ref);
+            err++;
+        }
+    }
+
+    /* data frame as the decoder sees it: header and length, then the payload */
+    t = host_now();
+    for(i=0; i<ROUNDS; i++)
+    {
+        crc = 0;
+        frame[6] = i;
+        crc16_update(&crc, frame, 4);
+        crc16_update(&crc, frame + 6, 512);
+        sink += crc;
+    }
+    t = (host_now() - t) / ROUNDS;
+
+    printf("crc16 impl %d: %s, %.0f ns per 512 byte frame (host)", KPTL_CRC16_IMPL, (err)?("FAIL"):("matches bitwise"), t * 1e9);
+#if (KPTL_CRC16_IMPL == 2)
+    printf(", engine %u word + %u byte writes for the payload", crc_model_wr32, crc_model_wr8);
+#endif
+    printf(" (sink %u)\n", sink);
+    return (err)?(1):(0);
+}
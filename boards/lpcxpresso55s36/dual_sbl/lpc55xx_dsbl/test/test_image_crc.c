@@ -0,0 +1,163 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    image_crc_range and FlashCrc32 on the flash model: a programmed range, a range with a blank
+    page (hashed as erased value, no bus fault), a RAM range (hashed in place) and a range with
+    a page torn by a power cut, which can not be read and must be reported as a failure.
+    a torn page must not be mapped: the ECC checked probe of memory_map fails on it, the
+    memory_read fallback fails too and the error is reported: two ECC errors per CRC on top of
+    the failed probes of blank pages.
+    ranges start and end inside a page.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "memory.h"
+#include "dimage.h"
+#include "mcuboot.h"
+#include "host.h"
+
+#define REGION          (0x20000)
+#define REGION_LEN      (8*512)
+#define CRC_ADDR        (REGION + 7)
+#define CRC_LEN         (REGION_LEN - 20)
+#define RAM_ADDR        (0x20000000)     /* SRAM, below 4GB like on the target */
+
+static mcuboot_t ctx;
+static uint8_t tx[1024];
+static uint32_t tx_len;
+static uint8_t data[REGION_LEN];
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    memcpy(tx + tx_len, buf, len);
+    tx_len += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+/* FlashCrc32 through mcuboot, status of the answer, crc from its third parameter */
+static uint32_t flash_crc32(uint32_t addr, uint32_t len, uint32_t *crc)
+{
+    uint8_t buf[64];
+    uint32_t param[2] = {addr, len};
+    blhost_frame_t f;
+    uint32_t pos = 0;
+
+    tx_len = 0;
+    mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_FlashCrc32, 2, param));
+    mcuboot_proc(&ctx);
+    mcuboot_proc(&ctx);
+    while(blhost_next(tx, tx_len, &pos, &f))
+    {
+        if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GenericResponse))
+        {
+            *crc = f.param[2];
+            return f.param[0];
+        }
+    }
+    return (uint32_t)-1;
+}
+
+/* fail: the range holds a torn page, ECC errors expected per CRC of it */
+static int check(const char *what, uint32_t addr, uint32_t len, const uint8_t *ref_data, uint32_t fail)
+{
+    uint32_t ref, crc, status, ecc;
+    int ret;
+
+    ref = crc32_compute((uint8_t *)ref_data, len);
+    ecc = flash_model_stat.ecc_err_cnt;
+    ret = image_crc_range(addr, len, &crc);
+    status = flash_crc32(addr, len, &crc);
+    ecc = flash_model_stat.ecc_err_cnt - ecc;
+    if(fail && (ecc != 2*fail))
+    {
+        printf("%s: %u ECC errors, expected %u, the probe and the memory_read fallback fail on the torn page\n", what, ecc, 2*fail);
+        return 1;
+    }
+    if((fail && (!ret || (status != MCUBOOT_STATUS_FAIL))) ||
+       (!fail && (ret || (status != MCUBOOT_STATUS_SUCCESS) || (crc != ref))))
+    {
+        printf("%s: image_crc_range %d, FlashCrc32 status %u crc 0x%08X, expected %s 0x%08X\n",
+               what, ret, status, crc, (fail)?("failure"):("success"), ref);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint8_t exp[REGION_LEN], *ram;
+    uint32_t i;
+    volatile int err = 0;
+
+    ram = mmap((void *)RAM_ADDR, REGION_LEN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(ram != (void *)RAM_ADDR)
+    {
+        printf("can not map RAM at 0x%x\n", (uint32_t)RAM_ADDR);
+        return 2;
+    }
+    for(i=0; i<REGION_LEN; i++)
+    {
+        data[i] = rand();
+        ram[i] = rand();
+    }
+
+    flash_model_reset();
+    memory_init();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_mem_crc32 = image_crc_range;
+    ctx.cfg_flash_start = REGION;
+    ctx.cfg_flash_size = REGION_LEN;
+    ctx.cfg_ram_start = RAM_ADDR;
+    ctx.cfg_ram_size = REGION_LEN;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+
+    /* programmed */
+    flash_model_load(REGION, data, REGION_LEN);
+    err += check("programmed", CRC_ADDR, CRC_LEN, data + 7, 0);
+
+    /* page 3 blank, reads as erased value */
+    memcpy(exp, data, REGION_LEN);
+    memset(exp + 3*512, 0xFF, 512);
+    memory_erase(REGION + 3*512, 512);
+    err += check("blank page", CRC_ADDR, CRC_LEN, exp + 7, 0);
+
+    /* RAM in place */
+    err += check("RAM", RAM_ADDR + 3, REGION_LEN - 9, ram + 3, 0);
+
+    /* page 5 torn by a power cut during its erase */
+    if(setjmp(flash_model_cut_jmp) == 0)
+    {
+        flash_model_cut_after(0);
+        memory_erase(REGION + 5*512, 512);
+    }
+    err += check("torn page", CRC_ADDR, CRC_LEN, exp + 7, 3);
+    err += check("before torn page", CRC_ADDR, 5*512 - 7, exp + 7, 0);
+    err += check("inside torn page", REGION + 5*512 + 100, 200, exp + 5*512 + 100, 2);
+
+    /* page 1 torn by a power cut during its program, range starts in it */
+    memory_erase(REGION + 1*512, 512);
+    if(setjmp(flash_model_cut_jmp) == 0)
+    {
+        flash_model_cut_after(0);
+        memory_write(REGION + 1*512, data + 1*512, 512);
+    }
+    err += check("torn by program", REGION + 1*512 + 9, 3*512, exp + 1*512 + 9, 2);
+
+    printf("image crc range: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
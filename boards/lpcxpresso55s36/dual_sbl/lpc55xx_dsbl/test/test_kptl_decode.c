@@ -0,0 +1,199 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    frame decoder: a stream of random command, data, ping and ACK frames, frames with a bad
+    CRC and line noise is decoded byte by byte and in random batches, both must deliver
+    exactly the good frames. then the work left for the last byte of a frame: the CRC runs
+    along with reception, so the last byte costs the same for any frame length.
+    built with the CRC engine implementation so the model counts the bytes each update hashes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kptl.h"
+#include "host.h"
+
+#define FRAME_CNT       (3000)
+#define STREAM_MAX      (FRAME_CNT * (6 + MAX_PACKET_LEN + 8))
+#define ROUNDS          (20000)
+
+typedef struct
+{
+    uint8_t type;
+    uint16_t len;
+    uint16_t sum;
+}rx_rec_t;
+
+static uint8_t stream[STREAM_MAX];
+static rx_rec_t expected[FRAME_CNT], got[FRAME_CNT];
+static uint32_t exp_cnt, got_cnt;
+static frame_packet_t fp;
+static pkt_dec_t dec;
+
+static uint16_t sum(const uint8_t *p, uint32_t len)
+{
+    uint16_t s = 0;
+
+    while(len--)
+    {
+        s = s * 31 + *p++;
+    }
+    return s;
+}
+
+static void on_frame(frame_packet_t *pkt)
+{
+    bool framed = (pkt->hr.packet_type == kFramingPacketType_Command) || (pkt->hr.packet_type == kFramingPacketType_Data);
+
+    /* length and payload are only meaningful for command and data frames */
+    if(got_cnt < FRAME_CNT)
+    {
+        got[got_cnt].type = pkt->hr.packet_type;
+        got[got_cnt].len = (framed)?(ARRAY2INT16(pkt->len)):(0);
+        got[got_cnt].sum = (framed)?(sum(pkt->payload, ARRAY2INT16(pkt->len))):(0);
+    }
+    got_cnt++;
+}
+
+static uint32_t build_stream(void)
+{
+    uint8_t payload[MAX_PACKET_LEN];
+    uint32_t param[7];
+    uint32_t i, j, len, n = 0;
+    int kind;
+
+    for(i=0; i<FRAME_CNT; i++)
+    {
+        kind = rand() % 6;
+        if(kind < 2)
+        {
+            n += blhost_short(stream + n, (kind)?(kFramingPacketType_Ack):(kFramingPacketType_Ping));
+            expected[exp_cnt].type = (kind)?(kFramingPacketType_Ack):(kFramingPacketType_Ping);
+            expected[exp_cnt].len = 0;
+            expected[exp_cnt++].sum = 0;
+            continue;
+        }
+
+        len = (rand() & 1)?(MAX_PACKET_LEN):(rand() % MAX_PACKET_LEN + 1);
+        for(j=0; j<len; j++)
+        {
+            payload[j] = rand();
+        }
+        if(kind == 2)
+        {
+            for(j=0; j<7; j++)
+            {
+                param[j] = rand();
+            }
+            len = blhost_cmd(stream + n, rand(), rand() % 8, param) - 6;
+            memcpy(payload, stream + n + 6, len);
+            n += len + 6;
+        }
+        else
+        {
+            n += blhost_data(stream + n, payload, len);
+        }
+
+        if(kind == 5)
+        {
+            /* corrupted on the line, length intact: dropped, decoder resyncs on the next frame */
+            stream[n - 1 - rand() % (len + 2)] ^= 1 << (rand() % 8);
+        }
+        else
+        {
+            expected[exp_cnt].type = (kind == 2)?(kFramingPacketType_Command):(kFramingPacketType_Data);
+            expected[exp_cnt].len = len;
+            expected[exp_cnt++].sum = sum(payload, len);
+        }
+
+        /* line noise between frames, never a start byte */
+        for(j=rand() % 3; j; j--)
+        {
+            stream[n++] = 0x00;
+        }
+    }
+    return n;
+}
+
+static void dec_reset(void)
+{
+    memset(&dec, 0, sizeof(dec));
+    dec.fp = &fp;
+    dec.cb = on_frame;
+    kptl_decode_init(&dec);
+    got_cnt = 0;
+}
+
+/* CRC bytes hashed and time spent by the call that takes the last byte of a data frame */
+static double last_byte(uint32_t len, uint32_t *hashed)
+{
+    uint8_t buf[6 + MAX_PACKET_LEN];
+    uint32_t n, i;
+    double t = 0, t0;
+
+    memset(buf + 6, 0x33, len);
+    n = blhost_data(buf, buf + 6, len);
+    for(i=0; i<ROUNDS; i++)
+    {
+        kptl_decode_buf(&dec, buf, n - 1);
+        crc_model_wr8 = 0;
+        crc_model_wr32 = 0;
+        t0 = host_now();
+        kptl_decode(&dec, buf[n - 1]);
+        t += host_now() - t0;
+        *hashed = crc_model_wr8 + 4*crc_model_wr32;
+    }
+    return t / ROUNDS;
+}
+
+int main(void)
+{
+    uint32_t len, i, n, h16, h512;
+    double t16, t512;
+    int mode, err = 0;
+
+    srand(5);
+    len = build_stream();
+
+    for(mode=0; mode<2; mode++)
+    {
+        dec_reset();
+        for(i=0; i<len; i+=n)
+        {
+            n = (mode)?(rand() % 700 + 1):(1);
+            n = (n > len - i)?(len - i):(n);
+            if(mode)
+            {
+                kptl_decode_buf(&dec, stream + i, n);
+            }
+            else
+            {
+                kptl_decode(&dec, stream[i]);
+            }
+        }
+        if((got_cnt != exp_cnt) || memcmp(got, expected, exp_cnt*sizeof(rx_rec_t)))
+        {
+            printf("%s: %u frames decoded, %u expected, or content differs\n", (mode)?("batches"):("per byte"), got_cnt, exp_cnt);
+            err++;
+        }
+    }
+
+    dec_reset();
+    t16 = last_byte(16, &h16);
+    t512 = last_byte(512, &h512);
+    if((h16 != 1) || (h512 != 1))
+    {
+        printf("last byte hashes %u bytes (16 byte frame), %u bytes (512 byte frame)\n", h16, h512);
+        err++;
+    }
+
+    printf("decoder: %s, %u frames in a %u byte stream\n", (err)?("FAIL"):("ok"), exp_cnt, len);
+    printf("last byte of a frame: %u byte hashed, %.0f ns for 16 bytes, %.0f ns for 512 bytes (host)\n", h512, t16 * 1e9, t512 * 1e9);
+    return (err)?(1):(0);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    SetProperty of the UART baud rate: the rate is checked against the USART divider
+    (USART_SetBaudRate of the SDK on a register block in RAM, FRO 12MHz like the board)
+    before the answer. a rate within 3% is answered with success at the old rate and then
+    switched to, any other is refused with InvalidPropertyValue and the rate stays.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fsl_usart.h"
+#include "mcuboot.h"
+#include "host.h"
+
+#define UART_CLK    (12000000)
+
+static mcuboot_t ctx;
+static uint8_t tx[4096];
+static uint32_t tx_len;
+static uint32_t set_cnt, set_baud, set_at;
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    memcpy(tx + tx_len, buf, len);
+    tx_len += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+static int op_check_baud(uint32_t baud)
+{
+    static USART_Type uart;
+
+    return (USART_SetBaudRate(&uart, baud, UART_CLK) == kStatus_Success)?(0):(-1);
+}
+
+static int op_set_baud(uint32_t baud)
+{
+    set_cnt++;
+    set_baud = baud;
+    set_at = tx_len;
+    return 0;
+}
+
+static uint32_t op_get_tick(void)
+{
+    return 0;
+}
+
+/* status of the SetProperty answer, -1 if there is none */
+static int32_t set_property(uint32_t baud)
+{
+    uint8_t buf[64];
+    uint32_t param[2] = {MCUBOOT_PROP_UART_BAUD, baud};
+    blhost_frame_t f;
+    uint32_t pos = 0;
+    int i;
+
+    tx_len = 0;
+    set_cnt = 0;
+    mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_SetProperty, 2, param));
+    for(i=0; i<4; i++)
+    {
+        mcuboot_proc(&ctx);
+    }
+    while(blhost_next(tx, tx_len, &pos, &f))
+    {
+        if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GenericResponse))
+        {
+            return f.param[0];
+        }
+    }
+    return -1;
+}
+
+int main(void)
+{
+    static const uint32_t rates[] = {9600, 115200, 230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000, 4000000, 0};
+    uint32_t i, reachable;
+    int32_t status;
+    int err = 0;
+
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_check_baud = op_check_baud;
+    ctx.op_set_baud = op_set_baud;
+    ctx.op_get_tick = op_get_tick;
+    ctx.cfg_tick_freq = 1000000;
+    ctx.cfg_uart_baud = 115200;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+
+    for(i=0; i<sizeof(rates)/sizeof(rates[0]); i++)
+    {
+        reachable = (rates[i] != 0) && (op_check_baud(rates[i]) == 0);
+        status = set_property(rates[i]);
+        printf("  %7u baud: %s, status %d\n", rates[i], (reachable)?("reachable"):("unreachable"), status);
+
+        /* switched once, after the answer went out at the old rate */
+        if(reachable && ((status != MCUBOOT_STATUS_SUCCESS) || (set_cnt != 1) || (set_baud != rates[i]) || (set_at != tx_len)))
+        {
+            printf("%u baud: not switched after a success answer\n", rates[i]);
+            err++;
+        }
+        if(!reachable && ((status != MCUBOOT_STATUS_INVALID_PROPERTY_VALUE) || set_cnt))
+        {
+            printf("%u baud: not refused or rate changed\n", rates[i]);
+            err++;
+        }
+    }
+
+    printf("baud rate property: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
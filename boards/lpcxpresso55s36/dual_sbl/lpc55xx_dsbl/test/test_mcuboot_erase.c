@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    FlashEraseRegion runs in the background: a WriteMemory sent during the erase waits in the
+    ring, a ping and a progress GetProperty queued behind it are answered at once. progress
+    counts up to the erase length, which a later WriteMemory of another length does not change.
+    the erase answer comes before the WriteMemory answer and the write lands in flash.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcuboot.h"
+#include "memory.h"
+#include "host.h"
+
+#define REGION          (0x20000)
+#define REGION_LEN      (64*1024)
+#define WR_LEN          (512)
+
+static mcuboot_t ctx;
+static uint8_t out[4096];
+static uint32_t out_len;
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    if(out_len + len <= sizeof(out))
+    {
+        memcpy(out + out_len, buf, len);
+    }
+    out_len += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+/* answers in the output since the last call: 'P' ping response, 'E' erase, 'W' WriteMemory,
+   'G' property response, ACKs are left out */
+static const char *answers(uint32_t *progress)
+{
+    static char s[64];
+    blhost_frame_t f;
+    uint32_t pos = 0, n = 0;
+
+    while(blhost_next(out, out_len, &pos, &f) && (n < sizeof(s) - 1))
+    {
+        if(f.type == kFramingPacketType_PingResponse)
+        {
+            s[n++] = 'P';
+        }
+        else if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GetPropertyResponse))
+        {
+            s[n++] = 'G';
+            progress[0] = f.param[1];
+            progress[1] = f.param[2];
+        }
+        else if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GenericResponse))
+        {
+            s[n++] = (f.param[1] == kCommandTag_FlashEraseRegion)?('E'):((f.param[1] == kCommandTag_WriteMemory)?('W'):('?'));
+        }
+    }
+    s[n] = 0;
+    out_len = 0;
+    return s;
+}
+
+static uint32_t cmd(uint8_t *buf, uint8_t tag, uint32_t cnt, uint32_t p0, uint32_t p1)
+{
+    uint32_t param[2] = {p0, p1};
+
+    return blhost_cmd(buf, tag, cnt, param);
+}
+
+int main(void)
+{
+    static uint8_t old[REGION_LEN];
+    uint8_t buf[1024], data[WR_LEN], flash[WR_LEN];
+    uint32_t n, i, progress[2] = {0, 0};
+    const char *a;
+    int err = 0;
+
+    for(i=0; i<WR_LEN; i++)
+    {
+        data[i] = rand();
+    }
+    memset(old, 0x5A, sizeof(old));
+    flash_model_reset();
+    flash_model_load(REGION, old, REGION_LEN);
+    memory_init();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_mem_write = memory_write;
+    ctx.op_mem_erase = memory_erase;
+    ctx.op_mem_read = memory_read;
+    ctx.op_mem_erase_start = memory_erase_start;
+    ctx.op_mem_erase_poll = memory_erase_poll;
+    ctx.cfg_flash_start = REGION;
+    ctx.cfg_flash_size = REGION_LEN;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+
+    mcuboot_recv(&ctx, buf, cmd(buf, kCommandTag_FlashEraseRegion, 2, REGION, REGION_LEN));
+    mcuboot_proc(&ctx);
+    answers(progress);
+
+    /* WriteMemory, ping and progress at once, the ring holds all three */
+    n = cmd(buf, kCommandTag_WriteMemory, 2, REGION, WR_LEN);
+    n += blhost_short(buf + n, kFramingPacketType_Ping);
+    n += cmd(buf + n, kCommandTag_GetProperty, 1, MCUBOOT_PROP_ERASE_PROGRESS, 0);
+    mcuboot_recv(&ctx, buf, n);
+    for(i=0; i<4; i++)
+    {
+        mcuboot_proc(&ctx);
+    }
+    a = answers(progress);
+    if(strcmp(a, "PG") || !ctx.erase_active || (progress[1] != REGION_LEN) || (progress[0] >= REGION_LEN))
+    {
+        printf("during erase: answers \"%s\", expected \"PG\", progress %u of %u, erase %s\n",
+               a, progress[0], progress[1], (ctx.erase_active)?("running"):("done"));
+        err++;
+    }
+
+    /* erase done, then the waiting WriteMemory */
+    for(i=0; (i < 100000) && ctx.erase_active; i++)
+    {
+        mcuboot_proc(&ctx);
+    }
+    for(i=0; i<4; i++)
+    {
+        mcuboot_proc(&ctx);
+    }
+    a = answers(progress);
+    if(strcmp(a, "EW"))
+    {
+        printf("after erase: answers \"%s\", expected \"EW\"\n", a);
+        err++;
+    }
+
+    mcuboot_recv(&ctx, buf, blhost_data(buf, data, WR_LEN));
+    mcuboot_recv(&ctx, buf, cmd(buf, kCommandTag_GetProperty, 1, MCUBOOT_PROP_ERASE_PROGRESS, 0));
+    for(i=0; i<8; i++)
+    {
+        mcuboot_proc(&ctx);
+    }
+    a = answers(progress);
+    flash_model_peek(REGION, flash, WR_LEN);
+    if(strcmp(a, "WG") || (progress[0] != REGION_LEN) || (progress[1] != REGION_LEN) || memcmp(flash, data, WR_LEN) ||
+       !memory_is_blank(REGION + WR_LEN, REGION_LEN - WR_LEN))
+    {
+        printf("after write: answers \"%s\", expected \"WG\", progress %u of %u, flash %s\n",
+               a, progress[0], progress[1], (memcmp(flash, data, WR_LEN))?("differs"):("ok"));
+        err++;
+    }
+
+    printf("erase in background: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
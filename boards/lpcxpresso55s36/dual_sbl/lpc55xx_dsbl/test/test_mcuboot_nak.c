@@ -0,0 +1,179 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    frames arriving while the receive ring is full: each dropped command or data frame is
+    answered with a NAK after the frames queued ahead of it, the host sends it again and
+    the session completes with the right flash content.
+    a NAK of a ReadMemory response or data frame makes the device send that frame again.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcuboot.h"
+#include "host.h"
+
+#define WR_ADDR     (0x10000)
+#define WR_LEN      (4*512)
+
+static mcuboot_t ctx;
+static uint8_t tx[64*1024];
+static uint32_t tx_len;
+static uint8_t flash[WR_LEN];
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    memcpy(tx + tx_len, buf, len);
+    tx_len += len;
+    return 0;
+}
+
+static int op_write(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    memcpy(&flash[addr - WR_ADDR], buf, len);
+    return 0;
+}
+
+static int op_read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    memcpy(buf, &flash[addr - WR_ADDR], len);
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+static void proc(int n)
+{
+    while(n--)
+    {
+        mcuboot_proc(&ctx);
+    }
+}
+
+/* frame types of the device's output since the last call, e.g. "A1 A4 A2" */
+static const char *output(void)
+{
+    static char s[256];
+    blhost_frame_t f;
+    uint32_t pos = 0, n = 0;
+
+    s[0] = 0;
+    while(blhost_next(tx, tx_len, &pos, &f) && (n < sizeof(s) - 4))
+    {
+        n += sprintf(s + n, "%s%02X", (n)?(" "):(""), f.type);
+    }
+    if(pos != tx_len)
+    {
+        sprintf(s + n, " (garbage)");
+    }
+    tx_len = 0;
+    return s;
+}
+
+static int expect(const char *what, const char *exp)
+{
+    const char *got = output();
+
+    if(strcmp(got, exp))
+    {
+        printf("%s: got \"%s\", expected \"%s\"\n", what, got, exp);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint8_t buf[8*1024], data[WR_LEN];
+    uint32_t n, i, param[2];
+    int err = 0;
+
+    ctx.op_send = op_send;
+    ctx.op_mem_write = op_write;
+    ctx.op_mem_read = op_read;
+    ctx.op_complete = op_complete;
+    ctx.cfg_flash_start = WR_ADDR;
+    ctx.cfg_flash_size = WR_LEN;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+
+    /* six commands at once: three fit in the ring, three are dropped */
+    param[0] = 1;
+    n = 0;
+    for(i=0; i<6; i++)
+    {
+        n += blhost_cmd(buf + n, kCommandTag_GetProperty, 1, param);
+    }
+    mcuboot_recv(&ctx, buf, n);
+    proc(10);
+    err += expect("full ring", "A1 A4 A1 A4 A1 A4 A2 A2 A2");
+    for(i=0; i<3; i++)
+    {
+        mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_GetProperty, 1, param));
+        proc(2);
+    }
+    err += expect("resent", "A1 A4 A1 A4 A1 A4");
+
+    /* data phase: four data frames at once, the last is dropped and sent again */
+    for(i=0; i<WR_LEN; i++)
+    {
+        data[i] = rand();
+    }
+    param[0] = WR_ADDR;
+    param[1] = WR_LEN;
+    mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_WriteMemory, 2, param));
+    proc(2);
+    err += expect("WriteMemory", "A1 A4");
+    n = 0;
+    for(i=0; i<4; i++)
+    {
+        n += blhost_data(buf + n, data + i*512, 512);
+    }
+    mcuboot_recv(&ctx, buf, n);
+    proc(10);
+    err += expect("data, full ring", "A1 A1 A1 A2");
+    mcuboot_recv(&ctx, buf, blhost_data(buf, data + 3*512, 512));
+    proc(10);
+    err += expect("data resent", "A1 A4");
+    if(memcmp(flash, data, WR_LEN))
+    {
+        printf("flash content differs\n");
+        err++;
+    }
+
+    /* ReadMemory, the host NAKs the response and the first data frame */
+    param[1] = 1024;
+    mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_ReadMemory, 2, param));
+    proc(2);
+    err += expect("ReadMemory", "A1 A4");
+    mcuboot_recv(&ctx, buf, blhost_short(buf, kFramingPacketType_Nak));
+    proc(2);
+    err += expect("response NAKed", "A4");
+    mcuboot_recv(&ctx, buf, blhost_short(buf, kFramingPacketType_Ack));
+    proc(2);
+    err += expect("response ACKed", "A5");
+    mcuboot_recv(&ctx, buf, blhost_short(buf, kFramingPacketType_Nak));
+    proc(2);
+    err += expect("data NAKed", "A5");
+    for(i=0; i<3; i++)
+    {
+        mcuboot_recv(&ctx, buf, blhost_short(buf, kFramingPacketType_Ack));
+        proc(2);
+    }
+    err += expect("read done", "A5 A4");
+    if(ctx.rd_state != kMcuboot_ReadIdle)
+    {
+        printf("ReadMemory not finished\n");
+        err++;
+    }
+
+    printf("full ring NAK: %s (%u frames dropped)\n", (err)?("FAIL"):("ok"), ctx.dec.overflow_cnt);
+    return (err)?(1):(0);
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    negotiated MaxPacketSize on a loopback: a host reads GetProperty 0x0B, then erases and
+    writes a 64KB image in data frames of that size, waiting for every answer like blhost.
+    the image must land in flash unchanged at every size. link time is modelled from the
+    bytes on the wire and a fixed turnaround per round trip (USB to UART bridge latency).
+    built with MAX_PACKET_LEN 4096.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcuboot.h"
+#include "memory.h"
+#include "host.h"
+
+#define REGION          (0x20000)
+#define REGION_LEN      (64*1024)
+#define IMAGE_LEN       (REGION_LEN - 100)
+#define LINK_BAUD       (921600)
+#define TURNAROUND_US   (1000)
+
+static mcuboot_t ctx;
+static uint8_t out[16*1024];
+static uint32_t out_len;
+static uint8_t image[IMAGE_LEN];
+static uint8_t frame[6 + MAX_PACKET_LEN];
+
+static struct
+{
+    uint32_t tx_bytes;          /* host to device */
+    uint32_t rx_bytes;          /* device to host */
+    uint32_t round_trips;       /* host frames waiting for an answer */
+}link;
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    if(out_len + len <= sizeof(out))
+    {
+        memcpy(out + out_len, buf, len);
+    }
+    out_len += len;
+    link.rx_bytes += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+static void device_init(uint32_t cfg_max_packet_len)
+{
+    flash_model_reset();
+    memory_init();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_mem_write = memory_write;
+    ctx.op_mem_erase = memory_erase;
+    ctx.op_mem_read = memory_read;
+    ctx.op_mem_erase_start = memory_erase_start;
+    ctx.op_mem_erase_poll = memory_erase_poll;
+    ctx.op_mem_map = memory_map;
+    ctx.cfg_flash_start = REGION;
+    ctx.cfg_flash_size = REGION_LEN;
+    ctx.cfg_max_packet_len = cfg_max_packet_len;
+    mcuboot_init(&ctx);
+    memset(&link, 0, sizeof(link));
+}
+
+/* send one frame, let the device run until it is idle, return its first command frame */
+static int transact(uint32_t len, int wait, blhost_frame_t *resp)
+{
+    blhost_frame_t f;
+    uint32_t pos = 0, quiet = 0, n;
+
+    out_len = 0;
+    link.tx_bytes += len;
+    link.round_trips += (wait)?(1):(0);
+    mcuboot_recv(&ctx, frame, len);
+    while(quiet < 8)
+    {
+        n = out_len;
+        mcuboot_proc(&ctx);
+        quiet = ((out_len == n) && !ctx.erase_active)?(quiet + 1):(0);
+    }
+
+    memset(resp, 0, sizeof(*resp));
+    while(blhost_next(out, out_len, &pos, &f))
+    {
+        if((f.type == kFramingPacketType_Command) && (resp->type == 0))
+        {
+            *resp = f;
+        }
+        else if(f.type == kFramingPacketType_Nak)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int command(uint8_t tag, uint32_t cnt, uint32_t p0, uint32_t p1, blhost_frame_t *resp)
+{
+    uint32_t param[2] = {p0, p1};
+    int ret;
+
+    ret = transact(blhost_cmd(frame, tag, cnt, param), 1, resp);
+    if(resp->type == kFramingPacketType_Command)
+    {
+        transact(blhost_short(frame, kFramingPacketType_Ack), 0, resp + 1);
+    }
+    return ret || (resp->type != kFramingPacketType_Command);
+}
+
+/* blhost write-memory at the negotiated packet size, 0: image verified in flash */
+static int session(uint32_t cfg_max_packet_len, uint32_t *pkt_len)
+{
+    static uint8_t flash[IMAGE_LEN];
+    blhost_frame_t r[2];
+    uint32_t off, n;
+
+    device_init(cfg_max_packet_len);
+    if(command(kCommandTag_GetProperty, 1, 0x0B, 0, r) || (r[0].tag != kCommandTag_GetPropertyResponse) || (r[0].param[1] == 0))
+    {
+        return 1;
+    }
+    *pkt_len = r[0].param[1];
+
+    if(command(kCommandTag_FlashEraseRegion, 2, REGION, REGION_LEN, r) || r[0].param[0])
+    {
+        return 1;
+    }
+    if(command(kCommandTag_WriteMemory, 2, REGION, IMAGE_LEN, r) || r[0].param[0])
+    {
+        return 1;
+    }
+    for(off=0; off<IMAGE_LEN; off+=n)
+    {
+        n = (IMAGE_LEN - off > *pkt_len)?(*pkt_len):(IMAGE_LEN - off);
+        if(transact(blhost_data(frame, image + off, n), 1, r))
+        {
+            return 1;
+        }
+    }
+    /* final response came with the last ACK */
+    if((r[0].type != kFramingPacketType_Command) || r[0].param[0])
+    {
+        return 1;
+    }
+    transact(blhost_short(frame, kFramingPacketType_Ack), 0, r);
+
+    flash_model_peek(REGION, flash, IMAGE_LEN);
+    return memcmp(flash, image, IMAGE_LEN) != 0;
+}
+
+int main(void)
+{
+    static const uint32_t sizes[] = {512, 1024, 2048, 4096};
+    static const uint32_t clamp[][2] = {{0, 4096}, {100, 512}, {1000, 512}, {1536, 1536}, {5000, 4096}};
+    uint32_t i, pkt_len;
+    double t;
+    int err = 0;
+
+    for(i=0; i<IMAGE_LEN; i++)
+    {
+        image[i] = rand();
+    }
+
+    /* configured size is clamped to whole pages within MAX_PACKET_LEN */
+    for(i=0; i<sizeof(clamp)/sizeof(clamp[0]); i++)
+    {
+        device_init(clamp[i][0]);
+        if(ctx.cfg_max_packet_len != clamp[i][1])
+        {
+            printf("cfg_max_packet_len %u: %u, expected %u\n", clamp[i][0], ctx.cfg_max_packet_len, clamp[i][1]);
+            err++;
+        }
+    }
+
+    printf("64KB write-memory, %d baud, %d us turnaround:\n", LINK_BAUD, TURNAROUND_US);
+    for(i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++)
+    {
+        if(session(sizes[i], &pkt_len) || (pkt_len != sizes[i]))
+        {
+            printf("packet size %u: session failed\n", sizes[i]);
+            err++;
+            continue;
+        }
+        t = (link.tx_bytes + link.rx_bytes) * 10.0 / LINK_BAUD + link.round_trips * TURNAROUND_US * 1e-6;
+        printf("  %4u byte packets: %3u round trips, %6u bytes on the wire, %4.0f ms, %5.1f KB/s\n",
+               pkt_len, link.round_trips, link.tx_bytes + link.rx_bytes, t * 1e3, IMAGE_LEN / 1024.0 / t);
+    }
+
+    printf("packet size: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    batch decode path: a blhost session is fed through mcuboot_recv byte by byte (the old
+    interrupt per byte path), in random batches and in the batches the DMA ring hands over
+    (half buffer events, ring wrap, main loop polls). every way must give the same device
+    output and the same flash content.
+
+    the session is generated (ping, GetProperty, FlashEraseRegion, WriteMemory of 64KB,
+    ReadMemory back, with the host ACKs blhost sends), or given as a capture of the bytes the
+    host sent:  test_mcuboot_stream [capture.bin]
+    host frames are replayed one at a time, each after the device has answered the previous one.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcuboot.h"
+#include "memory.h"
+#include "uart_dma.h"
+#include "host.h"
+
+#define REGION          (0x20000)
+#define REGION_LEN      (64*1024)
+#define IMAGE_LEN       (REGION_LEN - 100)
+#define SESSION_MAX     (256*1024)
+#define OUT_MAX         (256*1024)
+
+enum
+{
+    kFeed_Byte = 0,
+    kFeed_Random,
+    kFeed_Dma,
+    kFeed_Count,
+};
+
+static const char * const feed_name[kFeed_Count] = {"per byte", "random batches", "DMA ring"};
+
+static mcuboot_t ctx;
+static uint8_t session[SESSION_MAX];
+static uint32_t session_len;
+static uint8_t out[OUT_MAX];
+static uint32_t out_len;
+static uint8_t image[IMAGE_LEN];
+static uint32_t recv_calls;
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    if(out_len + len <= OUT_MAX)
+    {
+        memcpy(out + out_len, buf, len);
+    }
+    out_len += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+static void add(uint32_t len)
+{
+    session_len += len;
+}
+
+static void add_cmd(uint8_t tag, uint32_t cnt, uint32_t p0, uint32_t p1)
+{
+    uint32_t param[2] = {p0, p1};
+
+    add(blhost_cmd(session + session_len, tag, cnt, param));
+}
+
+static void add_ack(void)
+{
+    add(blhost_short(session + session_len, kFramingPacketType_Ack));
+}
+
+/* frames and ACKs as blhost sends them */
+static void session_generate(void)
+{
+    uint32_t off, n;
+
+    add(blhost_short(session, kFramingPacketType_Ping));
+    add_cmd(kCommandTag_GetProperty, 1, 0x01, 0);
+    add_ack();
+    add_cmd(kCommandTag_GetProperty, 1, 0x0B, 0);
+    add_ack();
+    add_cmd(kCommandTag_FlashEraseRegion, 2, REGION, REGION_LEN);
+    add_ack();
+    add_cmd(kCommandTag_WriteMemory, 2, REGION, IMAGE_LEN);
+    add_ack();
+    for(off=0; off<IMAGE_LEN; off+=n)
+    {
+        n = (IMAGE_LEN - off > 512)?(512):(IMAGE_LEN - off);
+        add(blhost_data(session + session_len, image + off, n));
+    }
+    add_ack();
+    add_cmd(kCommandTag_ReadMemory, 2, REGION + 1000, 2000);
+    add_ack();
+    for(off=0; off<2000; off+=512)
+    {
+        add_ack();
+    }
+    add_ack();
+}
+
+static int session_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if(!f)
+    {
+        return 1;
+    }
+    session_len = fread(session, 1, SESSION_MAX, f);
+    fclose(f);
+    return 0;
+}
+
+/* run the main loop until the device has nothing left to do */
+static void settle(void)
+{
+    uint32_t quiet = 0, len;
+
+    while(quiet < 8)
+    {
+        len = out_len;
+        mcuboot_proc(&ctx);
+        quiet = ((out_len == len) && !ctx.erase_active)?(quiet + 1):(0);
+    }
+}
+
+static void recv(uint8_t *buf, uint32_t len)
+{
+    recv_calls++;
+    mcuboot_recv(&ctx, buf, len);
+}
+
+/* one host frame reaches the device, handed over the way the receive path does it */
+static void feed(int mode, uint8_t *buf, uint32_t len)
+{
+    static uint32_t ring_pos;
+    uint32_t i, n, arrived;
+
+    switch(mode)
+    {
+        case kFeed_Byte:
+            for(i=0; i<len; i++)
+            {
+                recv(&buf[i], 1);
+            }
+            break;
+        case kFeed_Random:
+            for(i=0; i<len; i+=n)
+            {
+                n = rand() % 97 + 1;
+                n = (n > len - i)?(len - i):(n);
+                recv(&buf[i], n);
+                mcuboot_proc(&ctx);
+            }
+            break;
+        case kFeed_Dma:
+            /* some bytes arrive per main loop pass, a half buffer boundary raises the DMA
+               interrupt, the poll picks up the rest, the ring wrap splits a batch */
+            for(i=0; i<len; i+=arrived)
+            {
+                arrived = rand() % 80 + 1;
+                arrived = (arrived > len - i)?(len - i):(arrived);
+                for(n=0; n<arrived; )
+                {
+                    uint32_t room = UART_DMA_RX_HALF_SIZE - (ring_pos % UART_DMA_RX_HALF_SIZE);
+                    uint32_t k = (arrived - n > room)?(room):(arrived - n);
+
+                    recv(&buf[i + n], k);
+                    ring_pos = (ring_pos + k) % UART_DMA_RX_BUF_SIZE;
+                    n += k;
+                }
+                mcuboot_proc(&ctx);
+            }
+            break;
+    }
+}
+
+static void run(int mode)
+{
+    blhost_frame_t f;
+    uint32_t pos = 0, start;
+
+    flash_model_reset();
+    memory_init();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_mem_write = memory_write;
+    ctx.op_mem_erase = memory_erase;
+    ctx.op_mem_read = memory_read;
+    ctx.op_mem_erase_start = memory_erase_start;
+    ctx.op_mem_erase_poll = memory_erase_poll;
+    ctx.op_mem_map = memory_map;
+    ctx.cfg_flash_start = REGION;
+    ctx.cfg_flash_size = REGION_LEN;
+    ctx.cfg_flash_sector_size = 32*1024;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+    out_len = 0;
+    recv_calls = 0;
+    srand(3);
+
+    while(pos < session_len)
+    {
+        start = pos;
+        if(!blhost_next(session, session_len, &pos, &f))
+        {
+            /* not a frame, line noise goes to the device byte by byte */
+            pos = start + 1;
+        }
+        feed(mode, session + start, pos - start);
+        settle();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t ref_out[OUT_MAX], ref_flash[REGION_LEN], flash[REGION_LEN];
+    blhost_frame_t f;
+    uint32_t ref_len, pos, data_len, fail_cnt;
+    double t;
+    int mode, i, err = 0;
+
+    if(argc > 1)
+    {
+        if(session_load(argv[1]))
+        {
+            printf("can not read %s\n", argv[1]);
+            return 2;
+        }
+    }
+    else
+    {
+        for(i=0; i<IMAGE_LEN; i++)
+        {
+            image[i] = rand();
+        }
+        session_generate();
+    }
+
+    ref_len = 0;
+    for(mode=0; mode<kFeed_Count; mode++)
+    {
+        t = host_now();
+        run(mode);
+        t = host_now() - t;
+        flash_model_peek(REGION, flash, REGION_LEN);
+        printf("%-15s: %u session bytes, %u mcuboot_recv calls, %u output bytes, %.2f ms (host)\n",
+               feed_name[mode], session_len, recv_calls, out_len, t * 1e3);
+
+        if(mode == kFeed_Byte)
+        {
+            memcpy(ref_out, out, out_len);
+            memcpy(ref_flash, flash, REGION_LEN);
+            ref_len = out_len;
+        }
+        else if((out_len != ref_len) || memcmp(out, ref_out, out_len) || memcmp(flash, ref_flash, REGION_LEN))
+        {
+            printf("%s: device output or flash differs from byte by byte decoding\n", feed_name[mode]);
+            err++;
+        }
+    }
+
+    /* generated session: every response is a success and the image made it to flash and back */
+    if(argc <= 1)
+    {
+        pos = 0;
+        data_len = 0;
+        fail_cnt = 0;
+        while(blhost_next(ref_out, ref_len, &pos, &f))
+        {
+            if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GenericResponse) && f.param[0])
+            {
+                fail_cnt++;
+            }
+            if(f.type == kFramingPacketType_Data)
+            {
+                fail_cnt += (memcmp(f.payload, image + 1000 + data_len, f.len) != 0);
+                data_len += f.len;
+            }
+        }
+        if(fail_cnt || (pos != ref_len) || (data_len != 2000) || memcmp(ref_flash, image, IMAGE_LEN))
+        {
+            printf("session failed: %u errors, %u bytes read back\n", fail_cnt, data_len);
+            err++;
+        }
+    }
+
+    printf("batch decode: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    WriteMemory over a page that is not erased: data packets are ACKed before they are
+    programmed, so the final generic response must carry the program failure. packets after
+    the failing one are not programmed. the next WriteMemory starts clean and succeeds.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mcuboot.h"
+#include "memory.h"
+#include "host.h"
+
+#define REGION          (0x20000)
+#define PAGE_CNT        (8)
+#define BAD_PAGE        (3)
+
+static mcuboot_t ctx;
+static uint8_t out[4096];
+static uint32_t out_len;
+static uint8_t data[PAGE_CNT*512];
+
+static int op_send(uint8_t *buf, uint32_t len)
+{
+    if(out_len + len <= sizeof(out))
+    {
+        memcpy(out + out_len, buf, len);
+    }
+    out_len += len;
+    return 0;
+}
+
+static void op_complete(void)
+{
+}
+
+/* WriteMemory of the whole region one page per packet, status of the final response */
+static uint32_t write_memory(void)
+{
+    uint8_t buf[1024];
+    uint32_t param[2] = {REGION, sizeof(data)};
+    uint32_t i, pos = 0, status = (uint32_t)-1;
+    blhost_frame_t f;
+
+    out_len = 0;
+    mcuboot_recv(&ctx, buf, blhost_cmd(buf, kCommandTag_WriteMemory, 2, param));
+    mcuboot_proc(&ctx);
+    for(i=0; i<PAGE_CNT; i++)
+    {
+        mcuboot_recv(&ctx, buf, blhost_data(buf, data + i*512, 512));
+        mcuboot_proc(&ctx);
+    }
+    while(blhost_next(out, out_len, &pos, &f))
+    {
+        if((f.type == kFramingPacketType_Command) && (f.tag == kCommandTag_GenericResponse) &&
+           (f.param[1] == kCommandTag_WriteMemory))
+        {
+            status = f.param[0];
+        }
+    }
+    return status;
+}
+
+int main(void)
+{
+    uint8_t old[512], flash[512];
+    uint32_t i, status, fail;
+    int err = 0;
+
+    for(i=0; i<sizeof(data); i++)
+    {
+        data[i] = rand();
+    }
+    memset(old, 0x5A, sizeof(old));
+    flash_model_reset();
+    flash_model_load(REGION + BAD_PAGE*512, old, 512);
+    memory_init();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.op_send = op_send;
+    ctx.op_complete = op_complete;
+    ctx.op_mem_write = memory_write;
+    ctx.op_mem_read = memory_read;
+    ctx.cfg_flash_start = REGION;
+    ctx.cfg_flash_size = PAGE_CNT*512;
+    ctx.cfg_max_packet_len = 512;
+    mcuboot_init(&ctx);
+
+    fail = flash_model_stat.program_fail_cnt;
+    status = write_memory();
+    fail = flash_model_stat.program_fail_cnt - fail;
+    if((status == MCUBOOT_STATUS_SUCCESS) || (status == (uint32_t)-1) || (fail != 1))
+    {
+        printf("page %d not erased: final status %d, %u failed programs\n", BAD_PAGE, (int)status, fail);
+        err++;
+    }
+    for(i=0; i<PAGE_CNT; i++)
+    {
+        flash_model_peek(REGION + i*512, flash, 512);
+        if(((i < BAD_PAGE) && memcmp(flash, data + i*512, 512)) ||
+           ((i > BAD_PAGE) && (flash_model_page_state(REGION + i*512) != kFlashModel_Erased)))
+        {
+            printf("page %u: %s\n", i, (i < BAD_PAGE)?("not programmed"):("programmed after the failure"));
+            err++;
+        }
+    }
+
+    /* erased now, the next WriteMemory must not report the old failure */
+    memory_erase(REGION, PAGE_CNT*512);
+    status = write_memory();
+    flash_model_peek(REGION + BAD_PAGE*512, flash, 512);
+    if((status != MCUBOOT_STATUS_SUCCESS) || memcmp(flash, data + BAD_PAGE*512, 512))
+    {
+        printf("erased region: final status %d\n", (int)status);
+        err++;
+    }
+
+    printf("write failure status: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
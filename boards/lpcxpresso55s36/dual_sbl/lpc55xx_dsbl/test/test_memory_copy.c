@@ -0,0 +1,117 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    memory_copy_diff on the flash model: erased, identical, stale tail, torn and partly
+    different destinations must end as the source padded with 0xFF, without reading an
+    erased or torn page through the memory map. then cost against memory_copy.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "host.h"
+
+#define DST         (0x10000)
+#define SRC         (0x20000)
+#define LEN         (40000)         /* last page partly used */
+#define LEN_PAGES   ((LEN + 511) / 512 * 512)
+
+static uint8_t image[LEN_PAGES];
+static uint8_t check[LEN_PAGES];
+
+static int verify(const char *name, uint32_t exp_copied)
+{
+    const memory_stat_t *st = memory_get_stat();
+    uint32_t a;
+    int err = 0;
+
+    flash_model_peek(DST, check, LEN_PAGES);
+    for(a=DST; a<DST + LEN_PAGES; a+=512)
+    {
+        err += (flash_model_page_state(a) != kFlashModel_Programmed);
+    }
+    if(err || memcmp(check, image, LEN_PAGES))
+    {
+        printf("%s: destination differs from source\n", name);
+        return 1;
+    }
+    if(st->diff_copy_cnt != exp_copied)
+    {
+        printf("%s: %u pages copied, expected %u\n", name, st->diff_copy_cnt, exp_copied);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint8_t junk[512];
+    flash_model_stat_t s0;
+    double t_diff, t_copy;
+    volatile int err = 0;
+    int i;
+
+    memset(image, 0xFF, sizeof(image));
+    for(i=0; i<LEN; i++)
+    {
+        image[i] = rand();
+    }
+    memset(junk, 0x5A, sizeof(junk));
+    memory_init();
+    flash_model_load(SRC, image, LEN);
+
+    err += memory_copy_diff(DST, SRC, LEN);
+    err += verify("erased", LEN_PAGES / 512);
+
+    err += memory_copy_diff(DST, SRC, LEN);
+    err += verify("identical", 0);
+
+    /* old image was longer: tail page holds data past LEN */
+    memory_erase(DST + LEN_PAGES - 512, 512);
+    memcpy(junk, image + LEN_PAGES - 512, LEN % 512);
+    flash_model_load(DST + LEN_PAGES - 512, junk, 512);
+    err += memory_copy_diff(DST, SRC, LEN);
+    err += verify("stale tail", 1);
+
+    /* page torn by a power cut, reading it directly would fault */
+    flash_model_cut_after(0);
+    if(setjmp(flash_model_cut_jmp) == 0)
+    {
+        memory_erase(DST + 20*512, 512);
+    }
+    err += memory_copy_diff(DST, SRC, LEN);
+    err += verify("torn", 1);
+
+    /* two pages differ */
+    memory_erase(DST + 3*512, 512);
+    flash_model_load(DST + 3*512, junk, 512);
+    memory_erase(DST + 50*512, 512);
+    flash_model_load(DST + 50*512, junk, 512);
+    s0 = flash_model_stat;
+    t_diff = host_now();
+    err += memory_copy_diff(DST, SRC, LEN);
+    t_diff = host_now() - t_diff;
+    err += verify("two pages", 2);
+    printf("diff copy, 2 of %d pages differ: %u page ops, %u ROM calls, %.1f us (host)\n", LEN_PAGES / 512,
+           flash_model_stat.page_ops - s0.page_ops,
+           flash_model_stat.read_cnt + flash_model_stat.program_cnt + flash_model_stat.erase_cnt + flash_model_stat.verify_cnt -
+           s0.read_cnt - s0.program_cnt - s0.erase_cnt - s0.verify_cnt, t_diff * 1e6);
+
+    s0 = flash_model_stat;
+    t_copy = host_now();
+    err += memory_copy(DST, SRC, LEN);
+    t_copy = host_now() - t_copy;
+    printf("full copy:                    %u page ops, %u ROM calls, %.1f us (host)\n",
+           flash_model_stat.page_ops - s0.page_ops,
+           flash_model_stat.read_cnt + flash_model_stat.program_cnt + flash_model_stat.erase_cnt + flash_model_stat.verify_cnt -
+           s0.read_cnt - s0.program_cnt - s0.erase_cnt - s0.verify_cnt, t_copy * 1e6);
+
+    printf("memory_copy_diff: %s\n", (err)?("FAIL"):("ok"));
+    return (err)?(1):(0);
+}
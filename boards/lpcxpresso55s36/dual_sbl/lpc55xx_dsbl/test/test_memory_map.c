@@ -0,0 +1,131 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    memory_map on the flash model: a programmed range maps, a range with an erased page
+    anywhere in it does not, nor a range with a page torn by a power cut. then a 64KB image CRC in place against the old 64 byte
+    memory_read path: ROM calls and host time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "crc32.h"
+#include "host.h"
+
+#define IMAGE_ADDR      (0x10000)
+#define IMAGE_LEN       (64*1024)
+#define ROUNDS          (64)
+
+static uint8_t image[IMAGE_LEN];
+
+static uint32_t crc_read_path(void)
+{
+    uint8_t buf[64];
+    uint32_t crc, off;
+
+    crc32_init(&crc);
+    for(off=0; off<IMAGE_LEN; off+=sizeof(buf))
+    {
+        memory_read(IMAGE_ADDR + off, buf, sizeof(buf));
+        crc32_generate(&crc, buf, sizeof(buf));
+    }
+    crc32_complete(&crc);
+    return crc;
+}
+
+static uint32_t crc_map_path(void)
+{
+    const uint8_t *p = memory_map(IMAGE_ADDR, IMAGE_LEN);
+
+    return (p)?(crc32_compute((uint8_t *)p, IMAGE_LEN)):(0);
+}
+
+int main(void)
+{
+    flash_model_stat_t s0, s1;
+    uint32_t ref, crc, page;
+    double t_read, t_map;
+    volatile int err = 0;
+    int i;
+
+    for(i=0; i<IMAGE_LEN; i++)
+    {
+        image[i] = rand();
+    }
+    ref = crc32_compute(image, IMAGE_LEN);
+    memory_init();
+
+    flash_model_load(IMAGE_ADDR, image, IMAGE_LEN);
+    if((memory_map(IMAGE_ADDR, IMAGE_LEN) != (const uint8_t *)IMAGE_ADDR) ||
+       memcmp(memory_map(IMAGE_ADDR + 100, 1000), image + 100, 1000))
+    {
+        printf("programmed range not mapped\n");
+        err++;
+    }
+
+    /* an erased page at any position makes the range unmappable */
+    for(page=0; page<IMAGE_LEN; page+=512)
+    {
+        memory_erase(IMAGE_ADDR + page, 512);
+        if(memory_map(IMAGE_ADDR, IMAGE_LEN) || memory_map(IMAGE_ADDR + page + 3, 1))
+        {
+            printf("range with erased page 0x%x mapped\n", IMAGE_ADDR + page);
+            err++;
+        }
+        if(page && !memory_map(IMAGE_ADDR, page))
+        {
+            printf("range before erased page 0x%x not mapped\n", IMAGE_ADDR + page);
+            err++;
+        }
+        memory_write(IMAGE_ADDR + page, image + page, 512);
+    }
+    /* a torn page is neither blank nor hidden, reading it in place is a bus fault */
+    if(setjmp(flash_model_cut_jmp) == 0)
+    {
+        flash_model_cut_after(0);
+        memory_erase(IMAGE_ADDR + 7*512, 512);
+    }
+    if(memory_map(IMAGE_ADDR, IMAGE_LEN) || memory_map(IMAGE_ADDR + 7*512 + 100, 4) || !memory_map(IMAGE_ADDR, 7*512))
+    {
+        printf("range with torn page 0x%x mapped or range before it not mapped\n", (uint32_t)IMAGE_ADDR + 7*512);
+        err++;
+    }
+    memory_erase(IMAGE_ADDR + 7*512, 512);
+    memory_write(IMAGE_ADDR + 7*512, image + 7*512, 512);
+
+    if(memory_map(IMAGE_ADDR - 512, 512) || memory_map(FLASH_MODEL_SIZE - 512, 1024))
+    {
+        printf("erased or out of range page mapped\n");
+        err++;
+    }
+
+    s0 = flash_model_stat;
+    t_read = host_now();
+    for(i=0; i<ROUNDS; i++)
+    {
+        crc = crc_read_path();
+        err += (crc != ref);
+    }
+    t_read = (host_now() - t_read) / ROUNDS;
+    s1 = flash_model_stat;
+    t_map = host_now();
+    for(i=0; i<ROUNDS; i++)
+    {
+        crc = crc_map_path();
+        err += (crc != ref);
+    }
+    t_map = (host_now() - t_map) / ROUNDS;
+
+    printf("memory_map: %s\n", (err)?("FAIL"):("ok"));
+    printf("64KB crc, memory_read: %u ROM calls, %.1f us (host)\n", (s1.read_cnt - s0.read_cnt) / ROUNDS, t_read * 1e6);
+    printf("64KB crc, memory_map:  %u ROM calls, %.1f us (host)\n",
+           (flash_model_stat.read_cnt - s1.read_cnt + flash_model_stat.verify_cnt - s1.verify_cnt) / ROUNDS, t_map * 1e6);
+
+    return (err)?(1):(0);
+}
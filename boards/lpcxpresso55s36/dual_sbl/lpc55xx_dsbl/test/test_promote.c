@@ -0,0 +1,176 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    journaled backup promotion under power loss: golden holds version 1, backup version 2.
+    a boot is cut at every page operation (erase, program, journal record), the cut page is left
+    torn. then a second cut at every page operation of the next boot, and one more boot without
+    a cut. golden must then hold the backup image, pass its CRC check and the journal must be
+    closed. a read of a torn page in place is a bus fault of the flash model and fails the test.
+    the boot decision is the one of image_check_and_boot in copy mode.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "memory.h"
+#include "dimage.h"
+#include "promote.h"
+#include "sbl_api.h"
+#include "sbl_config.h"
+#include "host.h"
+
+#define IMAGE_LEN       (2*PROMOTE_CHUNK + 1500)
+#define HDR_OFF         (0x100)
+
+static uint8_t golden[GOLDEN_REGION_LEN], backup[BACKUP_REGION_LEN];
+
+/* image linked for golden region, CRC over everything but the crc_value field */
+static void image_build(uint8_t *img, uint32_t version)
+{
+    ihdr_t *hdr = (ihdr_t *)(img + HDR_OFF);
+    uint32_t i, crc, crc_off = HDR_OFF + offsetof(ihdr_t, crc_value);
+
+    for(i=0; i<IMAGE_LEN + 4; i++)
+    {
+        img[i] = rand();
+    }
+    *(uint32_t *)(img + 0x24) = 0x0FFEB6B6;
+    *(uint32_t *)(img + 0x28) = GOLDEN_REGION_START + HDR_OFF;
+    hdr->header_marker = HEADER_BLOCK_MARKER;
+    hdr->img_type = 0;
+    hdr->reserved = 0;
+    hdr->img_len = IMAGE_LEN;
+    hdr->version = version;
+    crc32_init(&crc);
+    crc32_generate(&crc, img, crc_off);
+    crc32_generate(&crc, img + crc_off + 4, IMAGE_LEN - crc_off);
+    crc32_complete(&crc);
+    hdr->crc_value = crc;
+}
+
+/* copy mode boot decision, 1 if the journal was open when it started */
+static int boot(void)
+{
+    sbl_nvm_t nvm;
+    uint32_t gaddr, baddr;
+    ihdr_t ghdr, bhdr;
+    int gcnt, bcnt, resumed;
+
+    memory_init();
+    sbl_nvm_init(&nvm);
+    resumed = (nvm.promote_src != 0);
+    gcnt = (nvm.promote_src)?(0):(image_scan(GOLDEN_REGION_START, GOLDEN_REGION_START, 512, &gaddr, 1));
+    bcnt = image_scan(BACKUP_REGION_START, GOLDEN_REGION_START, 512, &baddr, 1);
+    if(gcnt)
+    {
+        image_get_hdr(gaddr, GOLDEN_REGION_START, &ghdr);
+    }
+    if(bcnt)
+    {
+        image_get_hdr(baddr, GOLDEN_REGION_START, &bhdr);
+    }
+    if(bcnt && (!gcnt || (ghdr.version < bhdr.version)))
+    {
+        image_promote(baddr, &bhdr, &nvm);
+    }
+    return resumed;
+}
+
+/* boot with a power cut after cut page operations (-1: none), 1 if it was cut */
+static int boot_cut(int32_t cut, int *resumed)
+{
+    volatile int done = 0;
+
+    if(setjmp(flash_model_cut_jmp) == 0)
+    {
+        flash_model_cut_after(cut);
+        *resumed |= boot();
+        done = 1;
+    }
+    flash_model_cut_after(-1);
+    return !done;
+}
+
+static void setup(void)
+{
+    sbl_nvm_t nvm;
+
+    flash_model_reset();
+    memory_init();
+    flash_model_load(GOLDEN_REGION_START, golden, IMAGE_LEN + 4);
+    flash_model_load(BACKUP_REGION_START, backup, IMAGE_LEN + 4);
+    sbl_nvm_init(&nvm);
+}
+
+/* golden holds the backup image, it passes its check, the journal is closed */
+static int promoted(void)
+{
+    static uint8_t flash[IMAGE_LEN + 4];
+    sbl_nvm_t nvm;
+    uint32_t addr;
+    ihdr_t hdr;
+
+    sbl_nvm_init(&nvm);
+    flash_model_peek(GOLDEN_REGION_START, flash, IMAGE_LEN + 4);
+    if(memcmp(flash, backup, IMAGE_LEN + 4) || nvm.promote_src ||
+       (image_scan(GOLDEN_REGION_START, GOLDEN_REGION_START, 512, &addr, 1) != 1))
+    {
+        return 0;
+    }
+    image_get_hdr(addr, GOLDEN_REGION_START, &hdr);
+    return (hdr.version == 2);
+}
+
+int main(void)
+{
+    uint32_t ops, cut1, cut2, boots = 0, resumes = 0, fail1 = 0, fail2 = 0;
+    int resumed, err = 0;
+
+    image_build(golden, 1);
+    image_build(backup, 2);
+
+    /* page operations of an uninterrupted promotion */
+    setup();
+    ops = flash_model_stat.page_ops;
+    boot();
+    ops = flash_model_stat.page_ops - ops;
+    if(!promoted())
+    {
+        printf("promotion without power loss failed\n");
+        return 1;
+    }
+
+    for(cut1=0; cut1<ops; cut1++)
+    {
+        for(cut2=0; cut2<=ops; cut2++)
+        {
+            setup();
+            resumed = 0;
+            boot_cut(cut1, &resumed);
+            boot_cut((cut2 < ops)?((int32_t)cut2):(-1), &resumed);
+            boot_cut(-1, &resumed);
+            boots += 3;
+            resumes += resumed;
+            if(!promoted() && !err++)
+            {
+                fail1 = cut1;
+                fail2 = cut2;
+            }
+        }
+    }
+
+    if(err)
+    {
+        printf("cut after %u then %u page ops: golden does not hold the backup image (%d cut pairs fail)\n", fail1, fail2, err);
+    }
+
+    printf("promotion: %s, %u page ops, %u cut pairs, %u boots, %u resumed a journal\n",
+           (err)?("FAIL"):("ok"), ops, ops * (ops + 1), boots, resumes);
+    return (err)?(1):(0);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    parameter record log on the flash model.
+    wear: boots that each write one record, the banks are erased once per bank of records and
+    the erase counters carried in the records match the erases done.
+    power loss: from every fill level of the log (bank switches included) a write is cut at
+    every page operation it does. the next boot must read the old or the new record, never
+    defaults, and the log must keep working: the next write reads back.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbl_api.h"
+#include "sbl_config.h"
+#include "memory.h"
+#include "host.h"
+
+#define BOOT_CNT        (1000)
+#define BANK_PAGE_CNT   (BL_DATA_SIZE / 512 / 2)
+
+/* one boot of the bootloader that changes the parameters */
+static int boot(uint32_t value)
+{
+    sbl_nvm_t nvm;
+
+    sbl_nvm_init(&nvm);
+    nvm.write_gen = value;
+    return sbl_nvm_write(&nvm);
+}
+
+static uint32_t current(void)
+{
+    sbl_nvm_t nvm;
+
+    sbl_nvm_init(&nvm);
+    return (nvm.marker == BL_DATA_MARKER)?(nvm.write_gen):(0xFFFFFFFF);
+}
+
+static void log_reset(void)
+{
+    flash_model_reset();
+    memory_init();
+}
+
+int main(void)
+{
+    sbl_nvm_stat_t st;
+    uint32_t i, fill, got, page_erases;
+    volatile uint32_t cut, cuts = 0;
+    volatile int done, err = 0;
+
+    /* wear */
+    log_reset();
+    for(i=1; i<=BOOT_CNT; i++)
+    {
+        if(boot(i) || (current() != i))
+        {
+            printf("boot %u: record not read back\n", i);
+            err++;
+            break;
+        }
+    }
+    page_erases = memory_get_stat()->erase_page_cnt;
+    if(sbl_nvm_get_stat(&st) || (st.write_cnt != BOOT_CNT + 1) ||
+       ((st.bank_erase_cnt[0] + st.bank_erase_cnt[1]) * BANK_PAGE_CNT != page_erases) ||
+       ((st.bank_erase_cnt[0] + st.bank_erase_cnt[1]) != (st.write_cnt - 1) / BANK_PAGE_CNT - 1))
+    {
+        printf("wear: %u records, bank erases %u/%u, %u pages erased\n", st.write_cnt,
+               st.bank_erase_cnt[0], st.bank_erase_cnt[1], page_erases);
+        err++;
+    }
+    printf("  %d boots: %u records, bank erases %u/%u, %u page erases, %.1f records per page erase\n",
+           BOOT_CNT, st.write_cnt, st.bank_erase_cnt[0], st.bank_erase_cnt[1], page_erases,
+           (double)st.write_cnt / page_erases);
+
+    /* power loss at every page operation of a write, from every fill level */
+    for(fill=0; fill<=4*BANK_PAGE_CNT + 1; fill++)
+    {
+        for(cut=0; ; cut++)
+        {
+            log_reset();
+            for(i=1; i<=fill; i++)
+            {
+                boot(i);
+            }
+
+            done = 0;
+            if(setjmp(flash_model_cut_jmp) == 0)
+            {
+                flash_model_cut_after(cut);
+                boot(fill + 1);
+                done = 1;
+            }
+            flash_model_cut_after(-1);
+            cuts += !done;
+
+            /* the next boot: old or new, an empty log has no old record */
+            got = current();
+            if(!((got == fill + 1) || ((got == fill) && !done && fill) || ((got == 0) && !done && !fill)))
+            {
+                printf("fill %u, cut after %u page ops: read %u, expected %u%s\n", fill, cut, got, fill + 1, (done)?(""):(" or the old one"));
+                err++;
+            }
+            if(boot(fill + 2) || (current() != fill + 2))
+            {
+                printf("fill %u, cut after %u page ops: log broken, next write not read back\n", fill, cut);
+                err++;
+            }
+            if(done)
+            {
+                break;
+            }
+        }
+    }
+
+    printf("parameter log: %s, %u power cuts\n", (err)?("FAIL"):("ok"), cuts);
+    return (err)?(1):(0);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 NXP
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+    host decoder of the boot timeline, prints the same table as boot_prof_dump on target.
+    input is a raw little endian dump of boot_prof_t taken at BOOT_PROF_ADDR after the jump,
+    e.g. with J-Link Commander:  savebin boot_prof.bin 0x04003E00 0x108
+    built by test/Makefile:      make -C test build/boot_prof_decode
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "boot_prof.h"
+
+int main(int argc, char *argv[])
+{
+    boot_prof_t prof;
+    FILE *f;
+    size_t n;
+
+    if(argc != 2)
+    {
+        printf("usage: %s <dump of %u bytes at 0x%08X>\n", argv[0], (uint32_t)sizeof(prof), (uint32_t)BOOT_PROF_ADDR);
+        return 2;
+    }
+
+    f = fopen(argv[1], "rb");
+    if(!f)
+    {
+        printf("%s: can not open\n", argv[1]);
+        return 1;
+    }
+    memset(&prof, 0, sizeof(prof));
+    n = fread(&prof, 1, sizeof(prof), f);
+    fclose(f);
+
+    if(n < sizeof(prof))
+    {
+        printf("%s: %u bytes, a dump of %u bytes expected\n", argv[1], (uint32_t)n, (uint32_t)sizeof(prof));
+        return 1;
+    }
+    if(prof.magic != BOOT_PROF_MAGIC)
+    {
+        printf("%s: magic 0x%08X, no timeline (SBL_BOOT_PROFILE off or SRAMX overwritten)\n", argv[1], prof.magic);
+        return 1;
+    }
+
+    boot_prof_print(&prof);
+    return 0;
+}